@@ -0,0 +1,580 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "precision.h"
+#include "dlinklist.h"
+#include "stringmanip.h"
+#include "lexer.h"
+#include "simd.h"
+
+/*
+Maximum number of values an expression can have on its stack at 
+once. `compile_postfix` rejects anything deeper, which lets 
+`run_program` keep its whole stack in a fixed-size local array.
+*/
+#define PROGRAM_STACK_MAX 256
+
+/*
+Number of bindings `run_program_batch` evaluates together: one 
+block of this many values per stack slot stays in L1/L2 while 
+each instruction sweeps across it.
+*/
+#define PROGRAM_BATCH 256
+
+typedef enum {
+	OP_CONST,	// push consts[arg]
+	OP_VAR,		// push env[arg]
+	OP_ADD,
+	OP_SUB,
+	OP_MUL,
+	OP_DIV,
+	OP_POW,
+	OP_SIN,
+	OP_COS,
+	OP_TAN,
+	OP_ASIN,
+	OP_ACOS,
+	OP_ATAN,
+	OP_LOG10,
+	OP_LN,
+	OP_SQRT,
+	OP_EXP
+} opcode;
+
+typedef struct {
+	unsigned op;
+	unsigned arg;
+} instruction;
+
+/*
+Resolves a variable, by its interned name id, to its slot in an 
+evaluation environment, or returns -1 if the environment has no 
+such variable.
+*/
+typedef long (*slot_lookup)(void* ctx, size_t name);
+
+/*
+Native code compiled for a program by `jit_program`: its value, 
+and its value and gradient, for a contiguous environment.
+*/
+typedef scalar (*native_eval)(const scalar* env);
+typedef scalar (*native_gradient)(const scalar* env, scalar* grad);
+
+/*
+A postfix expression compiled to a flat list of instructions. 
+Numeric literals are parsed once into the constant pool `consts`, 
+and every variable reads a slot of the environment passed to 
+`run_program`, which has `nvars` slots; `names[slot]` is the 
+variable in that slot (NULL for slots the expression never reads). 
+The instructions, constants and names share the program's 
+single allocation; the names are interned (see `intern`), so they 
+outlive the list the program was compiled from, and two slots name 
+the same variable exactly when their pointers are equal. `tape` 
+and `links` are scratch space for `run_program_gradient`, which 
+makes a program unsafe to differentiate from two threads at once. 
+`native` and `native_gradient` are set once the program has been 
+compiled to machine code (see `jit_program`), which lives in the 
+separate mapping `native_code`.
+*/
+typedef struct {
+	size_t len;
+	size_t depth;
+	size_t nconsts;
+	size_t nvars;
+	scalar* consts;
+	scalar* tape;
+	char** names;
+	unsigned* links;
+	native_eval native;
+	native_gradient native_gradient;
+	void* native_code;
+	size_t native_size;
+	instruction code[];
+} program;
+
+size_t __align_up(size_t off, size_t align) {
+	return (off + align - 1) / align * align;
+}
+
+/*
+Token spellings of the opcodes, in the same order as `opcode` 
+starting at OP_ADD.
+*/
+const char* __op_names[] = {
+	"+", "-", "*", "/", "^",
+	"sin", "cos", "tan",
+	"arcsin", "arccos", "arctan",
+	"log", "ln", "sqrt", "exp",
+	NULL
+};
+
+extern void __jit_unmap(void* code, size_t size);
+
+void destroy_program(program* prog) {
+	if (prog->native_code)
+		__jit_unmap(prog->native_code, prog->native_size);
+	free(prog);
+	prog = NULL;
+}
+
+/*
+Allocates an empty program with room for `len` instructions, `len` 
+constants and `nnames` variable names, plus the scratch tape that 
+reverse mode sweeps over, all in one zeroed allocation. The 
+caller fills in the code and the counts.
+*/
+program* __new_program(size_t len, size_t nnames) {
+	size_t consts_at = __align_up(sizeof(program) + sizeof(instruction) * len, _Alignof(scalar));
+	size_t tape_at = consts_at + sizeof(scalar) * len;
+	size_t names_at = __align_up(tape_at + sizeof(scalar) * 2 * len, _Alignof(char*));
+	size_t links_at = names_at + sizeof(char*) * nnames;
+
+	program* prog = (program*)calloc(1, links_at + sizeof(unsigned) * 2 * len);
+	if (prog == NULL) {
+		puts("error: insufficient heap memory for new program");
+		return NULL;
+	}
+	prog->len = len;
+	prog->consts = (scalar*)((char*)prog + consts_at);
+	prog->tape = (scalar*)((char*)prog + tape_at);
+	prog->names = (char**)((char*)prog + names_at);
+	prog->links = (unsigned*)((char*)prog + links_at);
+	return prog;
+}
+
+/*
+Compiles a postfix expression (as produced by `shunting_yard`) 
+into a program whose variable slots are chosen by `lookup`: each 
+variable reads slot `lookup(ctx, id)` of the environment, where 
+`id` is its interned name, and the environment has `nslots` 
+slots. A negative slot means the variable is unknown, which fails 
+compilation. Without a `lookup`, slots are handed out in order of 
+first appearance.
+
+The tokens were already classified by the lexer, so compiling only 
+dispatches on their kinds and leaves them untouched; they can be 
+compiled again or evaluated some other way. Returns NULL if the 
+expression is malformed or too deep for `PROGRAM_STACK_MAX`.
+*/
+program* compile_postfix_bound(vector* rpn, slot_lookup lookup, void* ctx, size_t nslots) {
+	size_t len = rpn->len;
+
+	// room for the worst case: every token a distinct constant or variable
+	program* prog = __new_program(len, lookup && nslots > len ? nslots : len);
+	if (prog == NULL)
+		return NULL;
+	prog->nvars = lookup ? nslots : 0;
+
+	size_t depth = 0;
+	for (size_t pc = 0; pc < len; pc++) {
+		token* tok = &vector_item(rpn, token, pc);
+		instruction* ins = &prog->code[pc];
+
+		switch (tok->kind) {
+
+		case TOKEN_OPERATOR:
+			if (depth < 2) {
+				printf("error: operator '%s' is missing an operand. aborting compilation...\n", __op_names[tok->op - OP_ADD]);
+				destroy_program(prog);
+				return NULL;
+			}
+			*ins = (instruction){ tok->op, 0 };
+			depth--;
+			break;
+
+		case TOKEN_FUNCTION:
+			if (depth < 1) {
+				printf("error: function '%s' is missing its argument. aborting compilation...\n", __op_names[tok->op - OP_ADD]);
+				destroy_program(prog);
+				return NULL;
+			}
+			*ins = (instruction){ tok->op, 0 };
+			break;
+
+		case TOKEN_NUMBER: {
+			size_t slot = 0;
+			while (slot < prog->nconsts && prog->consts[slot] != tok->value)
+				slot++;
+			if (slot == prog->nconsts)
+				prog->consts[prog->nconsts++] = tok->value;
+			*ins = (instruction){ OP_CONST, (unsigned)slot };
+			depth++;
+			break;
+		}
+
+		case TOKEN_IDENT: {
+			char* name = interned_name(tok->name);
+			if (lookup) {
+				long slot = lookup(ctx, tok->name);
+				if (slot < 0 || (size_t)slot >= nslots) {
+					printf("error: found unknown variable '%s'. aborting compilation...\n", name);
+					destroy_program(prog);
+					return NULL;
+				}
+				prog->names[slot] = name;
+				*ins = (instruction){ OP_VAR, (unsigned)slot };
+			}
+			else {
+				size_t slot = 0;
+				while (slot < prog->nvars && prog->names[slot] != name)
+					slot++;
+				if (slot == prog->nvars)
+					prog->names[prog->nvars++] = name;
+				*ins = (instruction){ OP_VAR, (unsigned)slot };
+			}
+			depth++;
+			break;
+		}
+
+		default:
+			printf("error: found '");
+			print_token(tok);
+			puts("' in postfix expression. aborting compilation...");
+			destroy_program(prog);
+			return NULL;
+		}
+
+		if (depth > prog->depth)
+			prog->depth = depth;
+	}
+
+	if (depth != 1) {
+		puts("error: postfix expression doesn't reduce to one value. aborting compilation...");
+		destroy_program(prog);
+		return NULL;
+	}
+	if (prog->depth > PROGRAM_STACK_MAX) {
+		printf("error: expression needs a stack of %zu values, more than %d. aborting compilation...\n",
+			prog->depth, PROGRAM_STACK_MAX);
+		destroy_program(prog);
+		return NULL;
+	}
+	return prog;
+}
+
+/*
+Compiles a postfix expression, giving its variables slots in order 
+of first appearance. See `compile_postfix_bound`.
+*/
+program* compile_postfix(vector* rpn) {
+	return compile_postfix_bound(rpn, NULL, NULL, 0);
+}
+
+void print_program(program* prog) {
+	for (size_t pc = 0; pc < prog->len; pc++) {
+		instruction ins = prog->code[pc];
+		if (ins.op == OP_CONST)
+			printf("%4zu  const " SCALAR_FMT "\n", pc, prog->consts[ins.arg]);
+		else if (ins.op == OP_VAR)
+			printf("%4zu  var   %s (slot %u)\n", pc, prog->names[ins.arg], ins.arg);
+		else
+			printf("%4zu  %s\n", pc, __op_names[ins.op - OP_ADD]);
+	}
+}
+
+/*
+Applies an operator or function opcode to `x` (and `y` for the 
+binary operators), e.g. for folding constants at compile time.
+*/
+scalar apply_opcode(unsigned op, scalar x, scalar y) {
+	switch (op) {
+	case OP_ADD:	return x + y;
+	case OP_SUB:	return x - y;
+	case OP_MUL:	return x * y;
+	case OP_DIV:	return x / y;
+	case OP_POW:	return smath(pow)(x, y);
+	case OP_SIN:	return smath(sin)(x);
+	case OP_COS:	return smath(cos)(x);
+	case OP_TAN:	return smath(tan)(x);
+	case OP_ASIN:	return smath(asin)(x);
+	case OP_ACOS:	return smath(acos)(x);
+	case OP_ATAN:	return smath(atan)(x);
+	case OP_LOG10:	return smath(log10)(x);
+	case OP_LN:		return smath(log)(x);
+	case OP_SQRT:	return smath(sqrt)(x);
+	case OP_EXP:	return smath(exp)(x);
+	}
+	return (scalar)NAN;
+}
+
+/*
+Evaluates a compiled program against an environment whose slot `i` 
+is the scalar at byte offset `i * stride` from `env`. This lets a 
+program read variable values straight out of an array of structs 
+such as a varmap. Makes no heap allocations.
+*/
+scalar run_program_strided(program* prog, const void* env, size_t stride) {
+	scalar stack[PROGRAM_STACK_MAX];
+	scalar* sp = stack; // next free slot
+	const char* base = (const char*)env;
+
+	for (instruction* ins = prog->code, *end = prog->code + prog->len; ins < end; ins++) {
+		switch (ins->op) {
+		case OP_CONST:	*sp++ = prog->consts[ins->arg];					break;
+		case OP_VAR:	*sp++ = *(const scalar*)(base + ins->arg * stride);	break;
+		case OP_ADD:	sp--; sp[-1] = sp[-1] + sp[0];					break;
+		case OP_SUB:	sp--; sp[-1] = sp[-1] - sp[0];					break;
+		case OP_MUL:	sp--; sp[-1] = sp[-1] * sp[0];					break;
+		case OP_DIV:	sp--; sp[-1] = sp[-1] / sp[0];					break;
+		case OP_POW:	sp--; sp[-1] = smath(pow)(sp[-1], sp[0]);		break;
+		case OP_SIN:	sp[-1] = smath(sin)(sp[-1]);					break;
+		case OP_COS:	sp[-1] = smath(cos)(sp[-1]);					break;
+		case OP_TAN:	sp[-1] = smath(tan)(sp[-1]);					break;
+		case OP_ASIN:	sp[-1] = smath(asin)(sp[-1]);					break;
+		case OP_ACOS:	sp[-1] = smath(acos)(sp[-1]);					break;
+		case OP_ATAN:	sp[-1] = smath(atan)(sp[-1]);					break;
+		case OP_LOG10:	sp[-1] = smath(log10)(sp[-1]);					break;
+		case OP_LN:		sp[-1] = smath(log)(sp[-1]);					break;
+		case OP_SQRT:	sp[-1] = smath(sqrt)(sp[-1]);					break;
+		case OP_EXP:	sp[-1] = smath(exp)(sp[-1]);					break;
+		}
+	}
+	return stack[0];
+}
+
+/*
+Evaluates a compiled program. `env[slot]` holds the value of the 
+variable `prog->names[slot]`, and may be NULL for a program with 
+no variables. Runs the program's native code if it has any. Makes 
+no heap allocations.
+*/
+scalar run_program(program* prog, const scalar* env) {
+	if (prog->native)
+		return prog->native(env);
+	return run_program_strided(prog, env, sizeof(scalar));
+}
+
+/*
+Evaluates a compiled program in forward-mode automatic 
+differentiation, carrying every value as a dual number `v + d e`. 
+Returns the value of the expression and writes its exact derivative 
+w.r.t. environment slot `wrt` to `deriv`, in a single sweep. The 
+environment is laid out as for `run_program_strided`.
+*/
+scalar run_program_dual(program* prog, const void* env, size_t stride, size_t wrt, scalar* deriv) {
+	scalar v[PROGRAM_STACK_MAX], d[PROGRAM_STACK_MAX];
+	size_t top = 0; // next free slot
+	const char* base = (const char*)env;
+
+	for (instruction* ins = prog->code, *end = prog->code + prog->len; ins < end; ins++) {
+		scalar x = 0, dx = 0, y = 0, dy = 0;
+		if (ins->op >= OP_ADD && ins->op <= OP_POW) {
+			top--;
+			y = v[top];
+			dy = d[top];
+		}
+		if (ins->op >= OP_ADD) {
+			x = v[top - 1];
+			dx = d[top - 1];
+		}
+
+		switch (ins->op) {
+		case OP_CONST:
+			v[top] = prog->consts[ins->arg];
+			d[top++] = 0;
+			continue;
+		case OP_VAR:
+			v[top] = *(const scalar*)(base + ins->arg * stride);
+			d[top++] = ins->arg == wrt ? 1 : 0;
+			continue;
+		case OP_ADD:	v[top - 1] = x + y;	d[top - 1] = dx + dy;	break;
+		case OP_SUB:	v[top - 1] = x - y;	d[top - 1] = dx - dy;	break;
+		case OP_MUL:	v[top - 1] = x * y;	d[top - 1] = dx * y + x * dy;	break;
+		case OP_DIV:	v[top - 1] = x / y;	d[top - 1] = (dx * y - x * dy) / (y * y);	break;
+		case OP_POW:
+			// like reverse mode, only a positive base has a partial 
+			// w.r.t. the exponent
+			v[top - 1] = smath(pow)(x, y);
+			d[top - 1] = (dx != 0 ? y * smath(pow)(x, y - 1) * dx : 0)
+				+ (dy != 0 && x > 0 ? v[top - 1] * smath(log)(x) * dy : 0);
+			break;
+		case OP_SIN:	v[top - 1] = smath(sin)(x);	d[top - 1] = smath(cos)(x) * dx;	break;
+		case OP_COS:	v[top - 1] = smath(cos)(x);	d[top - 1] = -smath(sin)(x) * dx;	break;
+		case OP_TAN:
+			v[top - 1] = smath(tan)(x);
+			d[top - 1] = dx / (smath(cos)(x) * smath(cos)(x));
+			break;
+		case OP_ASIN:	v[top - 1] = smath(asin)(x);	d[top - 1] = dx / smath(sqrt)(1 - x * x);	break;
+		case OP_ACOS:	v[top - 1] = smath(acos)(x);	d[top - 1] = -dx / smath(sqrt)(1 - x * x);	break;
+		case OP_ATAN:	v[top - 1] = smath(atan)(x);	d[top - 1] = dx / (1 + x * x);	break;
+		case OP_LOG10:	v[top - 1] = smath(log10)(x);	d[top - 1] = dx / (x * smath(log)((scalar)10));	break;
+		case OP_LN:		v[top - 1] = smath(log)(x);	d[top - 1] = dx / x;	break;
+		case OP_SQRT:	v[top - 1] = smath(sqrt)(x);	d[top - 1] = dx / (2 * v[top - 1]);	break;
+		case OP_EXP:	v[top - 1] = smath(exp)(x);	d[top - 1] = v[top - 1] * dx;	break;
+		}
+	}
+	*deriv = d[0];
+	return v[0];
+}
+
+/*
+Evaluates a compiled program in reverse-mode automatic 
+differentiation. One forward sweep records every intermediate 
+value on the program's tape, and one backward sweep pushes the 
+adjoints back through it, so `grad[slot]` ends up holding the 
+exact partial derivative w.r.t. every one of the `prog->nvars` 
+environment slots at the cost of about two evaluations. Returns 
+the value of the expression. With a contiguous environment, a 
+program compiled by `jit_program` runs its native gradient, which 
+gives the same results.
+*/
+scalar run_program_gradient(program* prog, const void* env, size_t stride, scalar* grad) {
+	if (prog->native_gradient && stride == sizeof(scalar))
+		return prog->native_gradient((const scalar*)env, grad);
+
+	scalar* val = prog->tape;			// value produced by each instruction
+	scalar* adj = prog->tape + prog->len;	// adjoint of each instruction's value
+	unsigned* links = prog->links;		// instructions that produced each operand
+	unsigned producers[PROGRAM_STACK_MAX];
+	size_t top = 0;
+	const char* base = (const char*)env;
+
+	for (size_t pc = 0; pc < prog->len; pc++) {
+		instruction* ins = &prog->code[pc];
+		scalar x = 0, y = 0;
+		if (ins->op >= OP_ADD && ins->op <= OP_POW) {
+			links[2 * pc + 1] = producers[--top];
+			y = val[links[2 * pc + 1]];
+		}
+		if (ins->op >= OP_ADD) {
+			links[2 * pc] = producers[--top];
+			x = val[links[2 * pc]];
+		}
+
+		switch (ins->op) {
+		case OP_CONST:	val[pc] = prog->consts[ins->arg];	break;
+		case OP_VAR:	val[pc] = *(const scalar*)(base + ins->arg * stride);	break;
+		case OP_ADD:	val[pc] = x + y;	break;
+		case OP_SUB:	val[pc] = x - y;	break;
+		case OP_MUL:	val[pc] = x * y;	break;
+		case OP_DIV:	val[pc] = x / y;	break;
+		case OP_POW:	val[pc] = smath(pow)(x, y);	break;
+		case OP_SIN:	val[pc] = smath(sin)(x);	break;
+		case OP_COS:	val[pc] = smath(cos)(x);	break;
+		case OP_TAN:	val[pc] = smath(tan)(x);	break;
+		case OP_ASIN:	val[pc] = smath(asin)(x);	break;
+		case OP_ACOS:	val[pc] = smath(acos)(x);	break;
+		case OP_ATAN:	val[pc] = smath(atan)(x);	break;
+		case OP_LOG10:	val[pc] = smath(log10)(x);	break;
+		case OP_LN:		val[pc] = smath(log)(x);	break;
+		case OP_SQRT:	val[pc] = smath(sqrt)(x);	break;
+		case OP_EXP:	val[pc] = smath(exp)(x);	break;
+		}
+		adj[pc] = 0;
+		producers[top++] = (unsigned)pc;
+	}
+
+	for (size_t i = 0; i < prog->nvars; i++)
+		grad[i] = 0;
+
+	adj[prog->len - 1] = 1;
+	for (size_t pc = prog->len; pc-- > 0;) {
+		instruction* ins = &prog->code[pc];
+		scalar a = adj[pc];
+		if (a == 0 || ins->op == OP_CONST)
+			continue;
+		if (ins->op == OP_VAR) {
+			grad[ins->arg] += a;
+			continue;
+		}
+
+		unsigned l = links[2 * pc], r = links[2 * pc + 1];
+		scalar x = val[l], y = ins->op <= OP_POW ? val[r] : 0;
+
+		switch (ins->op) {
+		case OP_ADD:	adj[l] += a;	adj[r] += a;	break;
+		case OP_SUB:	adj[l] += a;	adj[r] -= a;	break;
+		case OP_MUL:	adj[l] += a * y;	adj[r] += a * x;	break;
+		case OP_DIV:	adj[l] += a / y;	adj[r] -= a * x / (y * y);	break;
+		case OP_POW:
+			adj[l] += a * y * smath(pow)(x, y - 1);
+			if (x > 0)
+				adj[r] += a * val[pc] * smath(log)(x);
+			break;
+		case OP_SIN:	adj[l] += a * smath(cos)(x);	break;
+		case OP_COS:	adj[l] -= a * smath(sin)(x);	break;
+		case OP_TAN:	adj[l] += a / (smath(cos)(x) * smath(cos)(x));	break;
+		case OP_ASIN:	adj[l] += a / smath(sqrt)(1 - x * x);	break;
+		case OP_ACOS:	adj[l] -= a / smath(sqrt)(1 - x * x);	break;
+		case OP_ATAN:	adj[l] += a / (1 + x * x);	break;
+		case OP_LOG10:	adj[l] += a / (x * smath(log)((scalar)10));	break;
+		case OP_LN:		adj[l] += a / x;	break;
+		case OP_SQRT:	adj[l] += a / (2 * val[pc]);	break;
+		case OP_EXP:	adj[l] += a * val[pc];	break;
+		}
+	}
+	return val[prog->len - 1];
+}
+
+/*
+Evaluates a compiled program over `n` variable bindings at once. 
+The environment is a structure of arrays: `cols[slot]` points to 
+the `n` values of variable slot `slot` (it may be NULL for slots 
+the program never reads), and `out[i]` receives the value of the 
+expression for binding `i`. Each instruction runs across a block 
+of `PROGRAM_BATCH` bindings with the vector kernels of simd.c, and 
+variables are read straight out of their columns. `tol` is the 
+relative error the caller accepts: at `VEC_APPROX_ERROR` or above, 
+exp, ln, sin and cos use polynomial approximations when `scalar` 
+is double (float and long double builds always use libm), and 
+with 0 every result matches `run_program` exactly. Functions 
+without a vector kernel fall back to libm one binding at a time. 
+Returns false if the scratch space can't be allocated.
+*/
+bool run_program_batch(program* prog, const scalar* const* cols, size_t n, scalar* out, scalar tol) {
+	scalar* scratch = (scalar*)malloc(sizeof(scalar) * PROGRAM_BATCH * (prog->depth ? prog->depth : 1));
+	if (scratch == NULL) {
+		puts("error: insufficient heap memory for batch evaluation");
+		return false;
+	}
+	bool approx = tol >= VEC_APPROX_ERROR;
+	const scalar* stack[PROGRAM_STACK_MAX];	// current block of each stack slot
+
+	for (size_t from = 0; from < n; from += PROGRAM_BATCH) {
+		size_t m = n - from < PROGRAM_BATCH ? n - from : PROGRAM_BATCH;
+		size_t top = 0; // next free slot
+
+		for (instruction* ins = prog->code, *end = prog->code + prog->len; ins < end; ins++) {
+			scalar* dst;
+			switch (ins->op) {
+			case OP_CONST:
+				dst = scratch + top * PROGRAM_BATCH;
+				for (size_t i = 0; i < m; i++)
+					dst[i] = prog->consts[ins->arg];
+				stack[top++] = dst;
+				continue;
+			case OP_VAR:
+				stack[top++] = cols[ins->arg] + from;
+				continue;
+			}
+
+			const scalar* y = NULL;
+			if (ins->op <= OP_POW)
+				y = stack[--top];
+			const scalar* x = stack[top - 1];
+			dst = scratch + (top - 1) * PROGRAM_BATCH;
+
+			switch (ins->op) {
+			case OP_ADD:
+			case OP_SUB:
+			case OP_MUL:
+			case OP_DIV:	scalar_fn(vec_binary)((vec_binop)(ins->op - OP_ADD), dst, x, y, m);	break;
+			case OP_SQRT:	scalar_fn(vec_unary)(VEC_SQRT, dst, x, m, approx);	break;
+			case OP_EXP:	scalar_fn(vec_unary)(VEC_EXP, dst, x, m, approx);	break;
+			case OP_LN:		scalar_fn(vec_unary)(VEC_LN, dst, x, m, approx);	break;
+			case OP_SIN:	scalar_fn(vec_unary)(VEC_SIN, dst, x, m, approx);	break;
+			case OP_COS:	scalar_fn(vec_unary)(VEC_COS, dst, x, m, approx);	break;
+			default:
+				for (size_t i = 0; i < m; i++)
+					dst[i] = apply_opcode(ins->op, x[i], y ? y[i] : 0);
+				break;
+			}
+			stack[top - 1] = dst;
+		}
+		memcpy(out + from, stack[0], sizeof(scalar) * m);
+	}
+
+	free(scratch);
+	return true;
+}
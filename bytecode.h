@@ -0,0 +1,80 @@
+#pragma once
+#include <stdlib.h>
+#include <stdbool.h>
+#include "precision.h"
+#include "dlinklist.h"
+
+#define PROGRAM_STACK_MAX 256
+
+#define PROGRAM_BATCH 256
+
+typedef enum {
+	OP_CONST,
+	OP_VAR,
+	OP_ADD,
+	OP_SUB,
+	OP_MUL,
+	OP_DIV,
+	OP_POW,
+	OP_SIN,
+	OP_COS,
+	OP_TAN,
+	OP_ASIN,
+	OP_ACOS,
+	OP_ATAN,
+	OP_LOG10,
+	OP_LN,
+	OP_SQRT,
+	OP_EXP
+} opcode;
+
+typedef struct {
+	unsigned op;
+	unsigned arg;
+} instruction;
+
+typedef long (*slot_lookup)(void* ctx, size_t name);
+
+typedef scalar (*native_eval)(const scalar* env);
+
+typedef scalar (*native_gradient)(const scalar* env, scalar* grad);
+
+typedef struct {
+	size_t len;
+	size_t depth;
+	size_t nconsts;
+	size_t nvars;
+	scalar* consts;
+	scalar* tape;
+	char** names;
+	unsigned* links;
+	native_eval native;
+	native_gradient native_gradient;
+	void* native_code;
+	size_t native_size;
+	instruction code[];
+} program;
+
+size_t __align_up(size_t off, size_t align);
+
+program* __new_program(size_t len, size_t nnames);
+
+program* compile_postfix_bound(vector* rpn, slot_lookup lookup, void* ctx, size_t nslots);
+
+program* compile_postfix(vector* rpn);
+
+void destroy_program(program* prog);
+
+void print_program(program* prog);
+
+scalar apply_opcode(unsigned op, scalar x, scalar y);
+
+scalar run_program_strided(program* prog, const void* env, size_t stride);
+
+scalar run_program(program* prog, const scalar* env);
+
+scalar run_program_dual(program* prog, const void* env, size_t stride, size_t wrt, scalar* deriv);
+
+scalar run_program_gradient(program* prog, const void* env, size_t stride, scalar* grad);
+
+bool run_program_batch(program* prog, const scalar* const* cols, size_t n, scalar* out, scalar tol);
@@ -1,26 +1,45 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "threadpool.h"
+#include "simd.h"
+#include "precision.h"
+#include <stdint.h>
+#include <stdbool.h>
 
+/*
+Byte alignment of every matrix buffer. Each row of a matrix 
+starts on a boundary of this size so that sweeps over a row 
+begin on a fresh cache line.
+*/
+#define CLINALG_ALIGN 64
+
+#define mac(x, j, i) (x)->data[(j) * (x)->stride + (i)]
 
 typedef struct {
 	size_t len;
-	long double data[];
+	scalar* data;
 } rowvec;
 
 typedef struct {
 	size_t rows;
 	size_t cols;
-	rowvec *data[];
+	size_t stride;
+	scalar* data;
 } matrix;
 
 /*
 Creates a new row vector pointer with all values initialized to 0.
+The header and the values share one allocation, so the vector is 
+freed with a single call to `free`.
 This operation is O(n) w.r.t. len of the vec.
 */
 rowvec *new_rowvec(size_t len) {
-	rowvec *p = (rowvec *)malloc(sizeof(rowvec) + sizeof(long double) * len);
+	rowvec *p = (rowvec *)malloc(sizeof(rowvec) + sizeof(scalar) * len);
 	if (p != NULL) {
 		p->len = len;
+		p->data = (scalar*)(p + 1);
 		for (int i = 0; i < (int)len; i++) {
 			p->data[i] = 0; // initialize to 0
 		}
@@ -29,38 +48,48 @@ rowvec *new_rowvec(size_t len) {
 }
 
 /*
-Private function to free all rows in a matrix. This function should only be used in 
-matrix constructor functions to free them in the event that one or more rows cannot 
-successfully be malloced.
+Returns the number of elements between the starts of two 
+consecutive rows in a matrix with `cols` columns. Rows are 
+padded so that each one begins on a `CLINALG_ALIGN` boundary.
+*/
+size_t __row_stride(size_t cols) {
+	size_t per_line = CLINALG_ALIGN / sizeof(scalar);
+	if (per_line == 0 || CLINALG_ALIGN % sizeof(scalar) != 0)
+		return cols; // alignment can't be kept per row, so pack rows tightly
+	return (cols + per_line - 1) / per_line * per_line;
+}
+
+/*
+Frees a matrix. The header and all of its rows live in a 
+single allocation, so this is one call to `free`.
 */
 void destroy_matrix(matrix* m) {
-	for (int i = 0; i < (int)m->rows; i++) {
-		free(m->data[i]); // free row
-		m->data[i] = NULL;
-	}
 	free(m);
 	m = NULL;
 }
 
 /*
 * Creates a new `m x n` matrix with the specified number of rows 
-* and columns. This operation is O(n * m) w.r.t. rows and cols.
+* and columns, with all values initialized to 0. The whole matrix 
+* is one allocation: the header followed by a `CLINALG_ALIGN`-aligned
+* row-major buffer of `rows * stride` values. 
+* This operation is O(n * m) w.r.t. rows and cols.
 */
 matrix *new_matrix(size_t rows, size_t cols) {
-	matrix *m = (matrix *)malloc(sizeof(matrix) + sizeof(rowvec *) * rows);
-	if (m != NULL) {
-		m->rows = 0;
-		m->cols = cols;
-		for (int i = 0; i < (int)rows; i++) {
-			rowvec *r = new_rowvec(cols);
-			if (r == NULL) { 
-				destroy_matrix(m); // free other rows if desired rows can't be malloced
-				return NULL;
-			}
-			m->data[i] = r;
-			m->rows++; // only increment once the row has successfully been added.
-		}
+	size_t stride = __row_stride(cols);
+	matrix *m = (matrix *)calloc(1, sizeof(matrix) + CLINALG_ALIGN + sizeof(scalar) * rows * stride);
+	if (m == NULL) {
+		puts("error: insufficient heap memory for new matrix");
+		return NULL;
 	}
+	m->rows = rows;
+	m->cols = cols;
+	m->stride = stride;
+
+	// place the buffer on the first aligned address after the header
+	uintptr_t buf = (uintptr_t)(m + 1);
+	buf = (buf + CLINALG_ALIGN - 1) & ~(uintptr_t)(CLINALG_ALIGN - 1);
+	m->data = (scalar*)buf;
 	return m;
 }
 
@@ -75,103 +104,125 @@ matrix *new_nxn(size_t n) {
 Creates an `n x n` identity matrix. This operation is O(n^2).
 */
 matrix *identity(size_t n) {
-	matrix *m = (matrix *)malloc(sizeof(matrix) + sizeof(rowvec*) * n);
+	matrix *m = new_nxn(n);
 	if (m != NULL) {
-		m->rows = 0;
-		m->cols = n;
-		for (int j=0; j < (int)n; j++) {
-			
-			// create new row or clean up if impossible
-			rowvec* r = (rowvec*)malloc(sizeof(rowvec) + sizeof(long double) * n);
-			if (r == NULL) {
-				destroy_matrix(m);
-				return NULL;
-			}
-			m->data[j] = r;
-			m->rows++;
-			m->data[j]->len = n;
-
-			// populate cells of matrix
-			for (int i = 0; i < (int)n; i++) {
-				if (i == j) {
-					m->data[j]->data[i] = 1;
-				} else {
-					m->data[j]->data[i] = 0;
-				}
-			}
-		}
+		for (int j = 0; j < (int)n; j++)
+			mac(m, j, j) = 1;
 	}
 	return m;
 }
 
 /*
-Adds pvec `b` scaled by `coef` to pvec `a`.
+Returns a view of row `j` of matrix `m`. The view borrows the 
+matrix's storage, so writes through it change the matrix and 
+it must not outlive the matrix or be freed.
+*/
+rowvec row_view(matrix* m, size_t j) {
+	return (rowvec){ m->cols, &mac(m, j, 0) };
+}
+
+/*
+Typed variants of the two innermost row loops, generated once per 
+supported scalar type: `row_axpy_<t>` adds `b * coef` to `a` and 
+`row_scale_<t>` multiplies `a` by `coef`, over `n` contiguous values. 
+These are the portable fallbacks behind the vectorized `vec_axpy_<t>` 
+and `vec_scale_<t>` in simd.c, which the rest of the library reaches 
+for its own scalar type through `scalar_fn(vec_axpy)` / `scalar_fn(vec_scale)`.
+*/
+#define DEFINE_ROW_KERNELS(suffix, type)								\
+void row_axpy_##suffix(type* a, const type* b, type coef, size_t n) {	\
+	for (size_t i = 0; i < n; i++)										\
+		a[i] += b[i] * coef;											\
+}																		\
+void row_scale_##suffix(type* a, type coef, size_t n) {					\
+	for (size_t i = 0; i < n; i++)										\
+		a[i] *= coef;													\
+}
+
+DEFINE_ROW_KERNELS(f, float)
+DEFINE_ROW_KERNELS(d, double)
+DEFINE_ROW_KERNELS(ld, long double)
+
+/*
+Adds rowvec `b` scaled by `coef` to rowvec `a`.
 */
-void row_add(rowvec* a, rowvec* b, long double coef) {
+void row_add(rowvec* a, rowvec* b, scalar coef) {
 	if (a->len != b->len)
 		puts("error: row vectors must have equal len");
 	else
-		for (int i = 0; i < a->len; i++)
-			a->data[i] += b->data[i] * coef;
+		scalar_fn(vec_axpy)(a->data, b->data, coef, a->len);
 }
 
 void print_rowvec(rowvec* r) {
 	printf("[");
 	for (int i = 0; i < r->len-1; i++) {
-		printf("%Lf, ", r->data[i]);
+		printf(SCALAR_FMT ", ", r->data[i]);
 	}
-	printf("%Lf]\n", r->data[r->len-1]);
+	printf(SCALAR_FMT "]\n", r->data[r->len-1]);
 }
 
 void print_matrix(matrix* m) {
 	printf("[\n");
 	for (int i = 0; i < m->rows; i++) {
+		rowvec r = row_view(m, i);
 		printf(" ");
-		print_rowvec(m->data[i]);
+		print_rowvec(&r);
 	}
 	printf("]\n");
 }
 
-typedef struct {
-	size_t len;
-	long double* data[];
-} pvec;
-
+/*
+A ptrix describes an augmented system `[A | B]` without copying 
+or pointing at individual elements. Columns `[0, split)` live in 
+the buffer `data[0]` and columns `[split, cols)` live in `data[1]`, 
+each with its own row stride, so every row operation is two 
+contiguous strided sweeps straight over the original matrices.
+*/
 typedef struct {
 	size_t rows;
 	size_t cols;
-	pvec* data[];
+	size_t split;
+	size_t stride[2];
+	scalar* data[2];
 } ptrix;
 
-/*Creates a ptrix (matrix w/ pointers to another matrix's values) from a 
+/*
+Accesses element `(j, i)` of a ptrix, picking the buffer that 
+holds column `i`.
+*/
+#define pac(p, j, i) (*((i) < (p)->split \
+	? &(p)->data[0][(j) * (p)->stride[0] + (i)] \
+	: &(p)->data[1][(j) * (p)->stride[1] + (i) - (p)->split]))
+
+/*
+Frees a ptrix. The values the ptrix describes are owned by 
+other matrices and are left untouched.
+*/
+void destroy_ptrix(ptrix* p) {
+	free(p);
+	p = NULL;
+}
+
+/*Creates a ptrix (a view over another matrix's values) from a 
 given matrix pointer.*/
 ptrix* __from_matrix(matrix* m) {
-	ptrix* p = (ptrix*)malloc(sizeof(ptrix) + sizeof(pvec*) * m->rows);
+	ptrix* p = (ptrix*)malloc(sizeof(ptrix));
 	if (p == NULL) {
 		puts("insufficient heap memory for new ptrix");
 		return NULL;
 	}
-	p->cols = m->cols;
 	p->rows = m->rows;
-
-	for (int j = 0; j < (int)m->rows; j++) {
-		pvec* pv = (pvec*)malloc(sizeof(pvec) + sizeof(long double*) * m->cols);
-		if (pv == NULL) {
-			destroy_matrix((matrix*)p);
-			return NULL;
-		}
-		p->data[j] = pv;
-		p->data[j]->len = p->cols;
-		for (int i = 0; i < (int)m->cols; i++) {
-			p->data[j]->data[i] = &m->data[j]->data[i]; // make references to m's indices
-		}
-	}
-
+	p->cols = m->cols;
+	p->split = m->cols;
+	p->stride[0] = m->stride;
+	p->stride[1] = 0;
+	p->data[0] = m->data;
+	p->data[1] = NULL; // no augmented columns
 	return p;
 }
 
-/*Combines two matrices into a ptrix with references to each
-matrix's elements. This appends the rows of b to the rows of a.
+/*Combines two matrices into a ptrix viewing each matrix's 
+elements. This appends the rows of b to the rows of a.
 Both matrices passed to this function must have the same number of 
 rows in order for this function to work.
 
@@ -184,113 +235,432 @@ ptrix* __augment(matrix* a, matrix* b) {
 		return NULL;
 	}
 
-	ptrix* p = (ptrix*)malloc(sizeof(ptrix) + sizeof(pvec*) * a->rows);
+	ptrix* p = (ptrix*)malloc(sizeof(ptrix));
 	if (p == NULL) {
 		puts("insufficient heap memory for new augment ptrix");
 		return NULL;
 	}
 	p->rows = a->rows;
 	p->cols = a->cols + b->cols;
+	p->split = a->cols;
+	p->stride[0] = a->stride;
+	p->stride[1] = b->stride;
+	p->data[0] = a->data;
+	p->data[1] = b->data;
+	return p;
+}
 
-	for (int j = 0; j < (int)p->rows; j++) {
-		pvec* pv = (pvec*)malloc(sizeof(pvec) + sizeof(long double*) * p->cols);
-		if (pv == NULL) {
-			destroy_matrix((matrix*)p);
-			puts("insufficient heap memory for one or more ptrix rows, aborting ptrix creation.");
-			return NULL;
-		}
-		p->data[j] = pv;
-		p->data[j]->len = p->cols;
-		for (int i = 0; i < (int)p->cols; i++) {
-			if (i < a->cols) {
-				p->data[j]->data[i] = &a->data[j]->data[i]; // make references to m's indices
-			} else {
-				p->data[j]->data[i] = &b->data[j]->data[i - (a->cols)];
-			}
-		}
-	}
+/*
+Adds row `src` of a ptrix scaled by `coef` to its row `dst`,
+touching only columns `from` onward. Columns to the left of 
+`from` are expected to be zero in `src` already.
+*/
+void __ptrix_row_add(ptrix* p, size_t dst, size_t src, scalar coef, size_t from) {
+	if (from < p->split)
+		scalar_fn(vec_axpy)(
+			p->data[0] + dst * p->stride[0] + from,
+			p->data[0] + src * p->stride[0] + from,
+			coef, p->split - from
+		);
 
-	return p;
+	if (p->split == p->cols)
+		return;
+
+	size_t off = from > p->split ? from - p->split : 0;
+	scalar_fn(vec_axpy)(
+		p->data[1] + dst * p->stride[1] + off,
+		p->data[1] + src * p->stride[1] + off,
+		coef, p->cols - p->split - off
+	);
 }
 
-void destroy_ptrix(ptrix* p) {
-	destroy_matrix((matrix*)p);
+/*
+Multiplies columns `from` onward of row `j` of a ptrix by `coef`.
+*/
+void __ptrix_row_scale(ptrix* p, size_t j, scalar coef, size_t from) {
+	if (from < p->split)
+		scalar_fn(vec_scale)(p->data[0] + j * p->stride[0] + from, coef, p->split - from);
+
+	if (p->split == p->cols)
+		return;
+
+	size_t off = from > p->split ? from - p->split : 0;
+	scalar_fn(vec_scale)(p->data[1] + j * p->stride[1] + off, coef, p->cols - p->split - off);
 }
 
-void print_pvec(pvec* p) {
-	//printf("%d\n", (int)p->len);
-	printf("[");
-	for (int i = 0; i < p->len-1; i++) {
-		printf("%Lf, ", *p->data[i]);
+/*
+Exchanges rows `a` and `b` of a ptrix across both halves of the 
+augmented system.
+*/
+void __ptrix_row_swap(ptrix* p, size_t a, size_t b) {
+	if (a == b)
+		return;
+
+	for (int h = 0; h < 2; h++) {
+		size_t len = h == 0 ? p->split : p->cols - p->split;
+		scalar* ra = p->data[h] + a * p->stride[h];
+		scalar* rb = p->data[h] + b * p->stride[h];
+		for (size_t i = 0; i < len; i++) {
+			scalar tmp = ra[i];
+			ra[i] = rb[i];
+			rb[i] = tmp;
+		}
 	}
-	printf("%Lf]\n", *p->data[p->len-1]);
 }
 
-void __pvec_add(pvec* a, pvec* b, long double coef) {
-	
-	// printf("Adding ");
-	// print_pvec(b);
-	// printf("to     ");
-	// print_pvec(a);
-	// printf("... * %Lf\n", coef);
-	
-	if (a->len != b->len)
-		puts("error: row pointer vectors must have equal len");
-	else
-		for (int i = 0; i < a->len; i++)
-			*a->data[i] += *b->data[i] * coef;
+/*
+Returns the row at or below row `o` with the largest magnitude 
+in column `o` (partial pivoting).
+*/
+size_t __pivot_row(ptrix* p, size_t o) {
+	size_t best = o;
+	scalar mag = smath(fabs)(pac(p, o, o));
+	for (size_t j = o + 1; j < p->rows; j++) {
+		if (smath(fabs)(pac(p, j, o)) > mag) {
+			mag = smath(fabs)(pac(p, j, o));
+			best = j;
+		}
+	}
+	return best;
 }
 
 void print_ptrix(ptrix* p) {
 	puts("[");
-	for (int i = 0; i < p->rows; i++) {
-		printf(" ");
-		print_pvec(p->data[i]);
+	for (size_t j = 0; j < p->rows; j++) {
+		printf(" [");
+		for (size_t i = 0; i + 1 < p->cols; i++)
+			printf(SCALAR_FMT ", ", pac(p, j, i));
+		printf(SCALAR_FMT "]\n", pac(p, j, p->cols - 1));
 	}
 	printf("]\n");
 }
 
-void __right_triangular(ptrix* p, size_t o) {
-	if (o == p->rows-1)
-		return;
+/*
+Number of threads that elimination spreads its row updates over.
+Values above 1 run the updates on a shared threadpool, which is 
+created on first use and rebuilt whenever this changes. Only one 
+thread should be reducing systems while this is above 1.
+*/
+size_t clinalg_threads = 1;
 
-	long double headhead = *p->data[o]->data[o];
-	for (int j = o + 1; j < p->rows; j++) {
+/*
+Fewest values a row update has to touch before it is worth 
+splitting across threads.
+*/
+#define CLINALG_PARALLEL_MIN 16384
+
+threadpool* __clinalg_pool = NULL;
+
+/*
+Runs `task` over rows `[lo, hi)`, split into row blocks across the 
+shared pool when there are threads to spare and `work` values to 
+update justify waking them. Otherwise runs it on this thread.
+*/
+void __parallel_rows(pool_task task, void* arg, size_t lo, size_t hi, size_t work) {
+	if (clinalg_threads > 1 && work >= CLINALG_PARALLEL_MIN && hi - lo > 1) {
+		if (__clinalg_pool != NULL && __clinalg_pool->nthreads != clinalg_threads) {
+			destroy_threadpool(__clinalg_pool);
+			__clinalg_pool = NULL;
+		}
+		if (__clinalg_pool == NULL)
+			__clinalg_pool = new_threadpool(clinalg_threads);
+		if (__clinalg_pool != NULL) {
+			threadpool_run(__clinalg_pool, task, arg, lo, hi);
+			return;
+		}
+	}
+	task(arg, lo, hi);
+}
+
+typedef struct {
+	ptrix* p;
+	size_t o;
+	scalar pivot;
+} __eliminate_arg;
+
+/*
+Clears column `o` from a block of rows using pivot row `o`. Each 
+row is independent of the others, so blocks can run concurrently.
+*/
+void __eliminate_rows(void* arg, size_t lo, size_t hi) {
+	__eliminate_arg* e = (__eliminate_arg*)arg;
+	for (size_t j = lo; j < hi; j++) {
 	
-		long double rowhead = *p->data[j]->data[o];
-		__pvec_add(p->data[j], p->data[o], -rowhead / headhead);
+		scalar rowhead = pac(e->p, j, e->o);
+		__ptrix_row_add(e->p, j, e->o, -rowhead / e->pivot, e->o);
 	}
+}
 
-	__right_triangular(p, ++o); // recurse on minor of 0,0 
+/*
+Eliminates column `o` from every row below row `o`, first swapping 
+the largest remaining entry of the column onto the diagonal so 
+that a zero or tiny pivot never gets divided by.
+*/
+void __eliminate_below(ptrix* p, size_t o) {
+	__ptrix_row_swap(p, o, __pivot_row(p, o));
+
+	__eliminate_arg e = { p, o, pac(p, o, o) };
+	__parallel_rows(__eliminate_rows, &e, o + 1, p->rows, (p->rows - o) * (p->cols - o));
 }
 
+/*
+Eliminates column `o` from every row above row `o`.
+*/
+void __eliminate_above(ptrix* p, size_t o) {
+	__eliminate_arg e = { p, o, pac(p, o, o) };
+	__parallel_rows(__eliminate_rows, &e, 0, o, o * (p->cols - o));
+}
+
+/*
+Zeroes everything below the diagonal from pivot `o` onward. 
+Runs in constant stack space for any number of rows.
+*/
+void __right_triangular(ptrix* p, size_t o) {
+	for (; o + 1 < p->rows; o++)
+		__eliminate_below(p, o); // move on to the minor of o,o
+}
+
+/*
+Zeroes everything above the diagonal from pivot `o` back to the 
+first row. Runs in constant stack space for any number of rows.
+*/
 void __left_triangular(ptrix* p, size_t o) {
-	if (o == 0)
-		return;
+	for (; o > 0 && o < p->rows; o--)
+		__eliminate_above(p, o); // move on to the minor of n,n
+}
 
-	long double tailtail = *p->data[o]->data[o];
-	for (int j = o - 1; j >= 0; j--) {
+void __scale_rows(void* arg, size_t lo, size_t hi) {
+	ptrix* p = (ptrix*)arg;
+	for (size_t j = lo; j < hi; j++)
+		__ptrix_row_scale(p, j, 1 / pac(p, j, j), j);
+}
 
-		long double rowtail = *p->data[j]->data[o];
-		__pvec_add(p->data[j], p->data[o], -rowtail / tailtail);
+void __scale_diagonal(ptrix* p) {
+	__parallel_rows(__scale_rows, p, 0, p->rows, p->rows * p->cols / 2);
+}
+
+/*
+Progress of a resumable reduction: which sweep it is in and the 
+next pivot that sweep will handle.
+*/
+typedef enum {
+	ELIM_FORWARD,
+	ELIM_BACKWARD,
+	ELIM_SCALE,
+	ELIM_DONE
+} elim_phase;
+
+typedef struct {
+	ptrix* p;
+	elim_phase phase;
+	size_t pivot;
+} elimination;
+
+/*
+Starts a resumable reduction of `p`. No work is done until the 
+elimination is passed to `continue_elimination`.
+*/
+elimination begin_elimination(ptrix* p) {
+	return (elimination){ p, p->rows > 0 ? ELIM_FORWARD : ELIM_DONE, 0 };
+}
+
+/*
+Advances a resumable reduction by at most `budget` pivot steps 
+(row eliminations or row scalings), returning true once the 
+ptrix is fully reduced. Between calls the whole state of the 
+reduction is the `elimination` struct plus the values of the 
+ptrix, so a caller can checkpoint both and pick the work back 
+up later or spread it across time slices.
+*/
+bool continue_elimination(elimination* e, size_t budget) {
+	ptrix* p = e->p;
+
+	while (budget > 0 && e->phase != ELIM_DONE) {
+		switch (e->phase) {
+		case ELIM_FORWARD:
+			if (e->pivot + 1 >= p->rows) {
+				e->phase = ELIM_BACKWARD;
+				e->pivot = p->rows - 1;
+				continue;
+			}
+			__eliminate_below(p, e->pivot++);
+			break;
+		case ELIM_BACKWARD:
+			if (e->pivot == 0) {
+				e->phase = ELIM_SCALE;
+				continue;
+			}
+			__eliminate_above(p, e->pivot--);
+			break;
+		case ELIM_SCALE:
+			if (e->pivot >= p->rows) {
+				e->phase = ELIM_DONE;
+				continue;
+			}
+			__ptrix_row_scale(p, e->pivot, 1 / pac(p, e->pivot, e->pivot), e->pivot);
+			e->pivot++;
+			break;
+		default:
+			break;
+		}
+		budget--;
 	}
+	return e->phase == ELIM_DONE;
+}
+
+/*
+Width of the pivot panels and column tiles used by the blocked 
+elimination path. Systems with more rows than this are reduced 
+with `__reduce_ptrix_blocked`; setting it to 0 or 1 always uses 
+the row-at-a-time kernels.
+*/
+size_t clinalg_tile_size = 64;
 
-	__left_triangular(p, --o); // recurse on minor of n,n 
+/*
+Subtracts a block of pivot rows from rows `[r_lo, r_hi)` of one 
+buffer, over the columns `[c_lo, c_hi)`. Row `r` receives 
+`l[r * ldl + q] * row(k0 + q)` for each `q < w`. Columns are walked 
+in tiles of `tile` so the `w` pivot row segments stay in cache 
+while every destination row streams past them.
+*/
+void __panel_update(scalar* base, size_t stride, size_t c_lo, size_t c_hi,
+	scalar* l, size_t ldl, size_t k0, size_t w, size_t r_lo, size_t r_hi, size_t tile) {
+
+	for (size_t c0 = c_lo; c0 < c_hi; c0 += tile) {
+		size_t c1 = c0 + tile < c_hi ? c0 + tile : c_hi;
+
+		for (size_t r = r_lo; r < r_hi; r++) {
+			scalar* dst = base + r * stride;
+			for (size_t q = 0; q < w; q++) {
+				scalar coef = l[r * ldl + q];
+				if (coef == 0)
+					continue;
+				scalar_fn(vec_axpy)(dst + c0, base + (k0 + q) * stride + c0, -coef, c1 - c0);
+			}
+		}
+	}
 }
 
-void __scale_diagonal(ptrix* p) {
+/*
+Applies `__panel_update` to every column of a ptrix at or right 
+of column `from`, covering both halves of the augmented system.
+*/
+void __ptrix_panel_update(ptrix* p, size_t from, scalar* l, size_t ldl,
+	size_t k0, size_t w, size_t r_lo, size_t r_hi, size_t tile) {
 
-	for (int j = 0; j < p->rows; j++) {
-		long double scalar = *p->data[j]->data[j];
-	
-		for (int i = 0; i < p->cols; i++) {
+	if (from < p->split)
+		__panel_update(p->data[0], p->stride[0], from, p->split, l, ldl, k0, w, r_lo, r_hi, tile);
+	if (p->split < p->cols)
+		__panel_update(p->data[1], p->stride[1], (from > p->split ? from - p->split : 0),
+			p->cols - p->split, l, ldl, k0, w, r_lo, r_hi, tile);
+}
 
-			*p->data[j]->data[i] /= scalar;
+typedef struct {
+	ptrix* p;
+	size_t from;
+	scalar* l;
+	size_t ldl;
+	size_t k0;
+	size_t w;
+	size_t tile;
+} __panel_arg;
+
+void __panel_rows(void* arg, size_t lo, size_t hi) {
+	__panel_arg* a = (__panel_arg*)arg;
+	__ptrix_panel_update(a->p, a->from, a->l, a->ldl, a->k0, a->w, lo, hi, a->tile);
+}
+
+/*
+Blocked Gauss-Jordan reduction. Pivots are taken `nb` at a time: 
+each panel of `nb` columns is eliminated on its own, keeping the 
+multipliers, and the rest of the system is then updated with one 
+tiled pass over the panel's pivot rows instead of one full-row 
+sweep per pivot. Returns false if scratch memory can't be had.
+*/
+bool __reduce_ptrix_blocked(ptrix* p, size_t nb) {
+	size_t n = p->rows;
+	scalar* l = (scalar*)malloc(sizeof(scalar) * n * nb);
+	if (l == NULL) {
+		puts("error: insufficient heap memory for elimination multipliers");
+		return false;
+	}
+
+	// forward pass: zero everything below the diagonal
+	for (size_t k0 = 0; k0 < n; k0 += nb) {
+		size_t k1 = k0 + nb < n ? k0 + nb : n;
+		size_t w = k1 - k0;
+
+		// eliminate inside the panel columns only, recording multipliers.
+		// Swapping whole rows is safe here since no row at or below `k` 
+		// has had its trailing columns touched for this panel yet.
+		for (size_t k = k0; k < k1; k++) {
+			size_t piv = __pivot_row(p, k);
+			if (piv != k) {
+				__ptrix_row_swap(p, k, piv);
+				for (size_t q = 0; q < k - k0; q++) {
+					scalar tmp = l[k * nb + q];
+					l[k * nb + q] = l[piv * nb + q];
+					l[piv * nb + q] = tmp;
+				}
+			}
+
+			scalar head = pac(p, k, k);
+			for (size_t j = k + 1; j < n; j++) {
+				scalar coef = pac(p, j, k) / head;
+				l[j * nb + (k - k0)] = coef;
+				pac(p, j, k) = 0;
+				for (size_t i = k + 1; i < k1; i++)
+					pac(p, j, i) -= coef * pac(p, k, i);
+			}
 		}
+
+		// bring the pivot rows' trailing columns up to date, top to bottom
+		for (size_t r = k0 + 1; r < k1; r++)
+			__ptrix_panel_update(p, k1, l, nb, k0, r - k0, r, r + 1, nb);
+
+		// then update every row below the panel in one tiled pass, 
+		// split into row blocks when running multithreaded
+		__panel_arg trailing = { p, k1, l, nb, k0, w, nb };
+		__parallel_rows(__panel_rows, &trailing, k1, n, (n - k1) * (p->cols - k1));
+	}
+
+	// backward pass: zero everything above the diagonal. Columns 
+	// right of a panel are already clear, so only the augmented 
+	// columns (and the panel itself) change.
+	size_t last = (n - 1) / nb * nb;
+	for (size_t k0 = last + nb; k0 >= nb; k0 -= nb) {
+		size_t lo = k0 - nb;
+		size_t hi = k0 < n ? k0 : n;
+		size_t w = hi - lo;
+
+		for (size_t k = lo; k < hi; k++) {
+			scalar tail = pac(p, k, k);
+			for (size_t j = 0; j < k; j++) {
+				l[j * nb + (k - lo)] = pac(p, j, k) / tail;
+				pac(p, j, k) = 0;
+			}
+			for (size_t j = k; j < hi; j++)
+				l[j * nb + (k - lo)] = 0;
+		}
+
+		// pivot rows depend on the pivot rows beneath them, bottom to top
+		for (size_t r = hi - 1; r-- > lo;)
+			__ptrix_panel_update(p, p->split, l + (r + 1 - lo), nb, r + 1, hi - r - 1, r, r + 1, nb);
+
+		__panel_arg above = { p, p->split, l, nb, lo, w, nb };
+		__parallel_rows(__panel_rows, &above, 0, lo, lo * (p->cols - p->split));
 	}
+
+	free(l);
+	__scale_diagonal(p);
+	return true;
 }
 
 void reduce_ptrix(ptrix *p) {
+	if (clinalg_tile_size > 1 && p->rows > clinalg_tile_size
+		&& __reduce_ptrix_blocked(p, clinalg_tile_size))
+		return;
+
 	__right_triangular(p, 0);
 	__left_triangular(p, p->rows-1);
 	__scale_diagonal(p);
@@ -298,8 +668,834 @@ void reduce_ptrix(ptrix *p) {
 
 matrix* invert(matrix* m) {
 	matrix* res = identity(m->rows);
+	if (res == NULL)
+		return NULL;
+
 	ptrix* p = __augment(m, res);
+	if (p == NULL) {
+		destroy_matrix(res);
+		return NULL;
+	}
 	reduce_ptrix(p);
+	destroy_ptrix(p);
 	destroy_matrix(m);
 	return res;
 }
+
+/*
+Partial-pivoting LU factors of a square matrix: `lu` holds the unit 
+lower triangle L below its diagonal and U on and above it, and 
+`perm[j]` is the row of the original matrix that became row `j`.
+*/
+typedef struct {
+	size_t n;
+	matrix* lu;
+	size_t perm[];
+} lu_factors;
+
+/*
+Returns a new matrix holding the same values as `m`.
+*/
+matrix* copy_matrix(matrix* m) {
+	matrix* res = new_matrix(m->rows, m->cols);
+	if (res != NULL)
+		memcpy(res->data, m->data, sizeof(scalar) * m->rows * m->stride);
+	return res;
+}
+
+void destroy_lu(lu_factors* f) {
+	destroy_matrix(f->lu);
+	free(f);
+	f = NULL;
+}
+
+/*
+Factors the square matrix `m` as `P m = L U` with partial pivoting.
+`m` is left untouched, so the same system can keep being used. 
+The factors can be reused by `lu_solve` for any number of right 
+hand sides at O(n^2) each. Returns NULL if `m` is singular or 
+memory runs out. This operation is O(n^3).
+*/
+lu_factors* lu_decompose(matrix* m) {
+	if (m->rows != m->cols) {
+		puts("error: only square matrices can be LU factored");
+		return NULL;
+	}
+
+	size_t n = m->rows;
+	lu_factors* f = (lu_factors*)malloc(sizeof(lu_factors) + sizeof(size_t) * n);
+	if (f == NULL) {
+		puts("error: insufficient heap memory for LU factors");
+		return NULL;
+	}
+	f->n = n;
+	f->lu = copy_matrix(m);
+	if (f->lu == NULL) {
+		free(f);
+		return NULL;
+	}
+	for (size_t j = 0; j < n; j++)
+		f->perm[j] = j;
+
+	matrix* a = f->lu;
+	for (size_t k = 0; k < n; k++) {
+
+		// bring the largest remaining entry of column k onto the diagonal
+		size_t piv = k;
+		for (size_t j = k + 1; j < n; j++)
+			if (smath(fabs)(mac(a, j, k)) > smath(fabs)(mac(a, piv, k)))
+				piv = j;
+
+		if (mac(a, piv, k) == 0) {
+			puts("error: matrix is singular and cannot be LU factored");
+			destroy_lu(f);
+			return NULL;
+		}
+
+		if (piv != k) {
+			rowvec rk = row_view(a, k), rp = row_view(a, piv);
+			for (size_t i = 0; i < n; i++) {
+				scalar tmp = rk.data[i];
+				rk.data[i] = rp.data[i];
+				rp.data[i] = tmp;
+			}
+			size_t tmp = f->perm[k];
+			f->perm[k] = f->perm[piv];
+			f->perm[piv] = tmp;
+		}
+
+		scalar* head = &mac(a, k, 0);
+		for (size_t j = k + 1; j < n; j++) {
+			scalar* row = &mac(a, j, 0);
+			scalar coef = row[k] / head[k];
+			row[k] = coef; // keep the multiplier as L
+			for (size_t i = k + 1; i < n; i++)
+				row[i] -= coef * head[i];
+		}
+	}
+	return f;
+}
+
+/*
+Solves `A x = b` into `x` with the factors of `A`: one forward 
+and one back substitution. `x` and `b` must not overlap.
+*/
+void __lu_substitute(lu_factors* f, const scalar* b, scalar* x) {
+
+	// forward substitution with the unit lower triangle
+	for (size_t j = 0; j < f->n; j++) {
+		scalar* row = &mac(f->lu, j, 0);
+		scalar sum = b[f->perm[j]];
+		for (size_t i = 0; i < j; i++)
+			sum -= row[i] * x[i];
+		x[j] = sum;
+	}
+
+	// back substitution with the upper triangle
+	for (size_t j = f->n; j-- > 0;) {
+		scalar* row = &mac(f->lu, j, 0);
+		scalar sum = x[j];
+		for (size_t i = j + 1; i < f->n; i++)
+			sum -= row[i] * x[i];
+		x[j] = sum / row[j];
+	}
+}
+
+/*
+Solves `A x = b` with the factors of `A`, returning a new rowvec `x`.
+This operation is O(n^2): one forward and one back substitution.
+*/
+rowvec* lu_solve(lu_factors* f, rowvec* b) {
+	if (b->len != f->n) {
+		puts("error: right hand side length doesn't match LU factors");
+		return NULL;
+	}
+
+	rowvec* x = new_rowvec(f->n);
+	if (x == NULL)
+		return NULL;
+
+	__lu_substitute(f, b->data, x->data);
+	return x;
+}
+
+/*
+Returns the inverse of the matrix `f` factors, solved for one 
+column at a time. Unlike `invert`, a singular matrix is caught 
+when it is factored rather than producing infinities here.
+*/
+matrix* lu_inverse(lu_factors* f) {
+	size_t n = f->n;
+	matrix* res = new_nxn(n);
+	scalar* col = (scalar*)calloc(2 * n + 1, sizeof(scalar));
+	if (res == NULL || col == NULL) {
+		puts("error: insufficient heap memory for matrix inverse");
+		if (res)
+			destroy_matrix(res);
+		free(col);
+		return NULL;
+	}
+
+	scalar* e = col + n;
+	for (size_t k = 0; k < n; k++) {
+		e[k] = 1;
+		__lu_substitute(f, e, col);
+		e[k] = 0;
+		for (size_t j = 0; j < n; j++)
+			mac(res, j, k) = col[j];
+	}
+	free(col);
+	return res;
+}
+
+/*
+A sparse matrix in compressed sparse row form: the nonzeros of 
+row `j` are `vals[k]`, in column `colidx[k]`, for `k` in 
+`[rowptr[j], rowptr[j + 1])`. Columns within a row need not be 
+sorted. The header and all three arrays are one allocation.
+*/
+typedef struct {
+	size_t rows;
+	size_t cols;
+	size_t nnz;
+	size_t* rowptr;
+	size_t* colidx;
+	scalar* vals;
+} csr_matrix;
+
+/*
+Creates an `rows x cols` CSR matrix with room for `nnz` nonzeros, 
+with every array zeroed. The caller fills in `rowptr` and `colidx`.
+*/
+csr_matrix* new_csr(size_t rows, size_t cols, size_t nnz) {
+	size_t idx = sizeof(size_t) * (rows + 1 + nnz);
+	csr_matrix* m = (csr_matrix*)calloc(1, sizeof(csr_matrix) + idx + CLINALG_ALIGN + sizeof(scalar) * nnz);
+	if (m == NULL) {
+		puts("error: insufficient heap memory for new sparse matrix");
+		return NULL;
+	}
+	m->rows = rows;
+	m->cols = cols;
+	m->nnz = nnz;
+	m->rowptr = (size_t*)(m + 1);
+	m->colidx = m->rowptr + rows + 1;
+
+	// place the values on the first aligned address after the indices
+	uintptr_t buf = (uintptr_t)m + sizeof(csr_matrix) + idx;
+	buf = (buf + CLINALG_ALIGN - 1) & ~(uintptr_t)(CLINALG_ALIGN - 1);
+	m->vals = (scalar*)buf;
+	return m;
+}
+
+void destroy_csr(csr_matrix* m) {
+	free(m);
+	m = NULL;
+}
+
+/*
+Returns a new CSR matrix with the same sparsity pattern as `m` and 
+every value zeroed.
+*/
+csr_matrix* csr_like(csr_matrix* m) {
+	csr_matrix* res = new_csr(m->rows, m->cols, m->nnz);
+	if (res == NULL)
+		return NULL;
+	memcpy(res->rowptr, m->rowptr, sizeof(size_t) * (m->rows + 1));
+	memcpy(res->colidx, m->colidx, sizeof(size_t) * m->nnz);
+	return res;
+}
+
+/*
+Returns a new dense matrix holding the values of `m`.
+*/
+matrix* csr_to_dense(csr_matrix* m) {
+	matrix* res = new_matrix(m->rows, m->cols);
+	if (res == NULL)
+		return NULL;
+	for (size_t j = 0; j < m->rows; j++)
+		for (size_t k = m->rowptr[j]; k < m->rowptr[j + 1]; k++)
+			mac(res, j, m->colidx[k]) += m->vals[k];
+	return res;
+}
+
+void print_csr(csr_matrix* m) {
+	printf("[ %zu x %zu, %zu nonzeros\n", m->rows, m->cols, m->nnz);
+	for (size_t j = 0; j < m->rows; j++) {
+		printf(" %zu:", j);
+		for (size_t k = m->rowptr[j]; k < m->rowptr[j + 1]; k++)
+			printf(" (%zu, " SCALAR_FMT ")", m->colidx[k], m->vals[k]);
+		printf("\n");
+	}
+	printf("]\n");
+}
+
+/*
+Sparse LU factors, recorded as the sequence of pivots the 
+elimination took. Step `k` pivoted on row `prow[k]` and column 
+`pcol[k]`, with pivot value `diag[k]`. It subtracted `lval[i]` times 
+the pivot row from row `lrow[i]`, for `i` in `[lptr[k], lptr[k + 1])`, 
+and the pivot row's remaining entries, all in columns pivoted on 
+later, are `uval[i]` in column `ucol[i]`, for `i` in 
+`[uptr[k], uptr[k + 1])`. Everything is one allocation.
+*/
+typedef struct {
+	size_t n;
+	size_t* prow;
+	size_t* pcol;
+	size_t* lptr;
+	size_t* lrow;
+	size_t* uptr;
+	size_t* ucol;
+	scalar* diag;
+	scalar* lval;
+	scalar* uval;
+} sparse_lu;
+
+void destroy_sparse_lu(sparse_lu* f) {
+	free(f);
+	f = NULL;
+}
+
+/*
+A row of the active submatrix during sparse elimination.
+*/
+typedef struct {
+	size_t len;
+	size_t cap;
+	size_t* col;
+	scalar* val;
+} __sprow;
+
+/*
+The rows that have an entry in one column of the active submatrix 
+(possibly including rows already pivoted on, which are skipped).
+*/
+typedef struct {
+	size_t len;
+	size_t cap;
+	size_t* row;
+} __spcol;
+
+bool __sprow_push(__sprow* r, size_t col, scalar val) {
+	if (r->len == r->cap) {
+		size_t cap = r->cap ? r->cap * 2 : 4;
+		size_t* c = (size_t*)realloc(r->col, sizeof(size_t) * cap);
+		if (c == NULL)
+			return false;
+		r->col = c;
+		scalar* v = (scalar*)realloc(r->val, sizeof(scalar) * cap);
+		if (v == NULL)
+			return false;
+		r->val = v;
+		r->cap = cap;
+	}
+	r->col[r->len] = col;
+	r->val[r->len] = val;
+	r->len++;
+	return true;
+}
+
+bool __spcol_push(__spcol* c, size_t row) {
+	if (c->len == c->cap) {
+		size_t cap = c->cap ? c->cap * 2 : 4;
+		size_t* r = (size_t*)realloc(c->row, sizeof(size_t) * cap);
+		if (r == NULL)
+			return false;
+		c->row = r;
+		c->cap = cap;
+	}
+	c->row[c->len++] = row;
+	return true;
+}
+
+/*
+Threshold for partial pivoting in `sparse_lu_decompose`: a pivot 
+may be picked for sparsity over the largest entry of its column as 
+long as it is at least this fraction of it.
+*/
+scalar clinalg_pivot_threshold = (scalar)0.1;
+
+/*
+Factors the square sparse matrix `a` (which is left untouched) with 
+right-looking Gaussian elimination over sparse rows, returning 
+NULL if it is singular.
+
+The ordering is picked as the elimination goes, to keep fill low 
+(a Markowitz-style rule): each step pivots on the active column 
+with the fewest entries and, among that column's entries within 
+`clinalg_pivot_threshold` of its largest, on the one in the 
+shortest row. Each step costs O(n) to pick the column plus the 
+merges of the pivot row into the rows below it, so a matrix that 
+stays sparse factors in far less than the O(n^3) of `lu_decompose`.
+*/
+sparse_lu* sparse_lu_decompose(csr_matrix* a) {
+	if (a->rows != a->cols) {
+		puts("error: only square matrices can be LU factored");
+		return NULL;
+	}
+
+	size_t n = a->rows;
+	sparse_lu* res = NULL;
+	bool ok = false;
+
+	__sprow* rows = (__sprow*)calloc(n + 1, sizeof(__sprow));
+	__spcol* cols = (__spcol*)calloc(n + 1, sizeof(__spcol));
+	size_t* count = (size_t*)calloc(n + 1, sizeof(size_t));	// active entries per column
+	size_t* pos = (size_t*)malloc(sizeof(size_t) * (n + 1));	// scatter map of the row being updated
+	bool* done_row = (bool*)calloc(n + 1, sizeof(bool));
+	bool* done_col = (bool*)calloc(n + 1, sizeof(bool));
+	size_t* prow = (size_t*)malloc(sizeof(size_t) * (n + 1));
+	size_t* pcol = (size_t*)malloc(sizeof(size_t) * (n + 1));
+	scalar* diag = (scalar*)malloc(sizeof(scalar) * (n + 1));
+	size_t* lptr = (size_t*)malloc(sizeof(size_t) * (n + 1));
+	size_t* uptr = (size_t*)malloc(sizeof(size_t) * (n + 1));
+	__sprow l = { 0 }, u = { 0 };	// L as (row, multiplier), U as (column, value)
+
+	if (!rows || !cols || !count || !pos || !done_row || !done_col
+		|| !prow || !pcol || !diag || !lptr || !uptr) {
+		puts("error: insufficient heap memory for sparse LU factors");
+		goto cleanup;
+	}
+
+	for (size_t j = 0; j < n; j++) {
+		pos[j] = SIZE_MAX;
+		for (size_t k = a->rowptr[j]; k < a->rowptr[j + 1]; k++) {
+			if (!__sprow_push(&rows[j], a->colidx[k], a->vals[k])
+				|| !__spcol_push(&cols[a->colidx[k]], j)) {
+				puts("error: insufficient heap memory for sparse LU factors");
+				goto cleanup;
+			}
+			count[a->colidx[k]]++;
+		}
+	}
+
+	for (size_t k = 0; k < n; k++) {
+		lptr[k] = l.len;
+		uptr[k] = u.len;
+
+		// the sparsest remaining column
+		size_t c = SIZE_MAX;
+		for (size_t i = 0; i < n; i++)
+			if (!done_col[i] && (c == SIZE_MAX || count[i] < count[c]))
+				c = i;
+
+		// its largest entry, then the shortest row within the threshold of it
+		scalar big = 0;
+		for (size_t i = 0; i < cols[c].len; i++) {
+			__sprow* r = &rows[cols[c].row[i]];
+			if (done_row[cols[c].row[i]])
+				continue;
+			for (size_t e = 0; e < r->len; e++)
+				if (r->col[e] == c && smath(fabs)(r->val[e]) > big)
+					big = smath(fabs)(r->val[e]);
+		}
+		if (big == 0) {
+			puts("error: matrix is singular and cannot be LU factored");
+			goto cleanup;
+		}
+
+		size_t p = SIZE_MAX;
+		for (size_t i = 0; i < cols[c].len; i++) {
+			size_t j = cols[c].row[i];
+			if (done_row[j] || (p != SIZE_MAX && rows[j].len >= rows[p].len))
+				continue;
+			for (size_t e = 0; e < rows[j].len; e++)
+				if (rows[j].col[e] == c && smath(fabs)(rows[j].val[e]) >= clinalg_pivot_threshold * big)
+					p = j;
+		}
+
+		// retire the pivot row into U
+		__sprow* pr = &rows[p];
+		prow[k] = p;
+		pcol[k] = c;
+		done_row[p] = true;
+		done_col[c] = true;
+		for (size_t e = 0; e < pr->len; e++) {
+			count[pr->col[e]]--;
+			if (pr->col[e] == c)
+				diag[k] = pr->val[e];
+			else if (!__sprow_push(&u, pr->col[e], pr->val[e])) {
+				puts("error: insufficient heap memory for sparse LU factors");
+				goto cleanup;
+			}
+		}
+
+		// eliminate column c from every other active row that has it
+		for (size_t i = 0; i < cols[c].len; i++) {
+			size_t j = cols[c].row[i];
+			if (done_row[j])
+				continue;
+			__sprow* r = &rows[j];
+
+			size_t at = 0;
+			while (r->col[at] != c)
+				at++;
+			scalar coef = r->val[at] / diag[k];
+			r->len--;
+			r->col[at] = r->col[r->len];
+			r->val[at] = r->val[r->len];
+			count[c]--;
+			if (!__sprow_push(&l, j, coef)) {
+				puts("error: insufficient heap memory for sparse LU factors");
+				goto cleanup;
+			}
+
+			for (size_t e = 0; e < r->len; e++)
+				pos[r->col[e]] = e;
+			for (size_t e = 0; e < pr->len; e++) {
+				size_t col = pr->col[e];
+				if (col == c)
+					continue;
+				if (pos[col] != SIZE_MAX)
+					r->val[pos[col]] -= coef * pr->val[e];
+				else {
+					if (!__sprow_push(r, col, -coef * pr->val[e]) || !__spcol_push(&cols[col], j)) {
+						puts("error: insufficient heap memory for sparse LU factors");
+						goto cleanup;
+					}
+					pos[col] = r->len - 1;
+					count[col]++;
+				}
+			}
+			for (size_t e = 0; e < r->len; e++)
+				pos[r->col[e]] = SIZE_MAX;
+		}
+	}
+	lptr[n] = l.len;
+	uptr[n] = u.len;
+
+	// pack the factors into one allocation
+	size_t idx = sizeof(size_t) * (4 * n + 2 + l.len + u.len);
+	res = (sparse_lu*)malloc(sizeof(sparse_lu) + idx + _Alignof(scalar) + sizeof(scalar) * (n + l.len + u.len));
+	if (res == NULL) {
+		puts("error: insufficient heap memory for sparse LU factors");
+		goto cleanup;
+	}
+	res->n = n;
+	res->prow = (size_t*)(res + 1);
+	res->pcol = res->prow + n;
+	res->lptr = res->pcol + n;
+	res->uptr = res->lptr + n + 1;
+	res->lrow = res->uptr + n + 1;
+	res->ucol = res->lrow + l.len;
+	uintptr_t buf = (uintptr_t)res + sizeof(sparse_lu) + idx;
+	buf = (buf + _Alignof(scalar) - 1) & ~(uintptr_t)(_Alignof(scalar) - 1);
+	res->diag = (scalar*)buf;
+	res->lval = res->diag + n;
+	res->uval = res->lval + l.len;
+
+	memcpy(res->prow, prow, sizeof(size_t) * n);
+	memcpy(res->pcol, pcol, sizeof(size_t) * n);
+	memcpy(res->lptr, lptr, sizeof(size_t) * (n + 1));
+	memcpy(res->uptr, uptr, sizeof(size_t) * (n + 1));
+	memcpy(res->diag, diag, sizeof(scalar) * n);
+	if (l.len) {
+		memcpy(res->lrow, l.col, sizeof(size_t) * l.len);
+		memcpy(res->lval, l.val, sizeof(scalar) * l.len);
+	}
+	if (u.len) {
+		memcpy(res->ucol, u.col, sizeof(size_t) * u.len);
+		memcpy(res->uval, u.val, sizeof(scalar) * u.len);
+	}
+	ok = true;
+
+cleanup:
+	for (size_t j = 0; rows && cols && j < n; j++) {
+		free(rows[j].col);
+		free(rows[j].val);
+		free(cols[j].row);
+	}
+	free(rows);
+	free(cols);
+	free(count);
+	free(pos);
+	free(done_row);
+	free(done_col);
+	free(prow);
+	free(pcol);
+	free(diag);
+	free(lptr);
+	free(uptr);
+	free(l.col);
+	free(l.val);
+	free(u.col);
+	free(u.val);
+	return ok ? res : NULL;
+}
+
+/*
+Solves `A x = b` into `x` with the sparse factors of `A`, replaying 
+the eliminations on `b` and back-substituting in reverse pivot 
+order. `work` must hold `n` values; `b` is left untouched. This is 
+O(n + nonzeros of the factors).
+*/
+void __sparse_lu_substitute(sparse_lu* f, const scalar* b, scalar* x, scalar* work) {
+	memcpy(work, b, sizeof(scalar) * f->n);
+
+	for (size_t k = 0; k < f->n; k++) {
+		scalar piv = work[f->prow[k]];
+		for (size_t i = f->lptr[k]; i < f->lptr[k + 1]; i++)
+			work[f->lrow[i]] -= f->lval[i] * piv;
+	}
+
+	for (size_t k = f->n; k-- > 0;) {
+		scalar sum = work[f->prow[k]];
+		for (size_t i = f->uptr[k]; i < f->uptr[k + 1]; i++)
+			sum -= f->uval[i] * x[f->ucol[i]];
+		x[f->pcol[k]] = sum / f->diag[k];
+	}
+}
+
+/*
+Solves `A x = b` with the sparse factors of `A`, returning a new 
+rowvec `x`.
+*/
+rowvec* sparse_lu_solve(sparse_lu* f, rowvec* b) {
+	if (b->len != f->n) {
+		puts("error: right hand side length doesn't match LU factors");
+		return NULL;
+	}
+
+	rowvec* x = new_rowvec(f->n);
+	scalar* work = (scalar*)malloc(sizeof(scalar) * (f->n + 1));
+	if (x == NULL || work == NULL) {
+		free(x);
+		free(work);
+		return NULL;
+	}
+
+	__sparse_lu_substitute(f, b->data, x->data, work);
+	free(work);
+	return x;
+}
+
+/*
+Colors the columns of the sparsity pattern of `p` so that no two 
+columns of the same color have an entry in the same row, writing 
+each column's color to `color` (which must hold `p->cols` values) 
+and returning the number of colors. Columns of one color are 
+structurally orthogonal: perturbing all of them at once changes 
+each row through at most one of them, which is what lets a 
+finite-difference Jacobian recover a whole color group per 
+evaluation.
+
+Columns are colored greedily in order, each with the lowest color 
+none of its neighbours has; a banded pattern gets as many colors 
+as it has bandwidth. Returns 0 if memory runs out.
+*/
+size_t csr_color_columns(csr_matrix* p, size_t* color) {
+	size_t n = p->cols;
+	size_t* colptr = (size_t*)calloc(n + 1, sizeof(size_t));
+	size_t* rowidx = (size_t*)malloc(sizeof(size_t) * (p->nnz + 1));
+	size_t* seen = (size_t*)malloc(sizeof(size_t) * (n + 1));	// column that last ruled each color out
+	if (colptr == NULL || rowidx == NULL || seen == NULL) {
+		puts("error: insufficient heap memory for column coloring");
+		free(colptr);
+		free(rowidx);
+		free(seen);
+		return 0;
+	}
+
+	// the rows of each column
+	for (size_t k = 0; k < p->nnz; k++)
+		colptr[p->colidx[k] + 1]++;
+	for (size_t i = 0; i < n; i++)
+		colptr[i + 1] += colptr[i];
+	for (size_t j = 0; j < p->rows; j++) {
+		for (size_t k = p->rowptr[j]; k < p->rowptr[j + 1]; k++)
+			rowidx[colptr[p->colidx[k]]++] = j;
+	}
+	for (size_t i = n; i > 0; i--)
+		colptr[i] = colptr[i - 1];
+	colptr[0] = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		color[i] = SIZE_MAX;
+		seen[i] = SIZE_MAX;
+	}
+
+	size_t ncolors = 0;
+	for (size_t i = 0; i < n; i++) {
+		for (size_t r = colptr[i]; r < colptr[i + 1]; r++) {
+			size_t j = rowidx[r];
+			for (size_t k = p->rowptr[j]; k < p->rowptr[j + 1]; k++)
+				if (color[p->colidx[k]] != SIZE_MAX)
+					seen[color[p->colidx[k]]] = i;
+		}
+
+		size_t c = 0;
+		while (seen[c] == i)
+			c++;
+		color[i] = c;
+		if (c + 1 > ncolors)
+			ncolors = c + 1;
+	}
+
+	free(colptr);
+	free(rowidx);
+	free(seen);
+	return ncolors;
+}
+
+/*
+Permutes the square sparsity pattern of `p` to block lower 
+triangular form: with rows taken in the order `rowperm` and 
+columns in the order `colperm`, every entry lies on or below the 
+diagonal blocks, and block `b` spans positions 
+`[blockptr[b], blockptr[b + 1])`. `rowperm` and `colperm` must hold 
+`n` values and `blockptr` `n + 1`. Returns the number of blocks, 
+or 0 if the pattern is structurally singular (no permutation puts 
+a nonzero on every diagonal position).
+
+In a system of equations, this says which equations (rows) can be 
+solved for which unknowns (columns) alone, and in what order: 
+block `b` only involves the unknowns of blocks `0..b`.
+
+The diagonal comes from a maximum matching of rows to columns 
+(depth-first augmenting paths), and the blocks are the strongly 
+connected components, found with Tarjan's algorithm, of the graph 
+with an edge from row `i` to the row matched with each column row 
+`i` has an entry in. Both searches keep their own stacks, so deep 
+dependency chains can't overflow the call stack.
+*/
+size_t csr_block_triangularize(csr_matrix* p, size_t* rowperm, size_t* colperm, size_t* blockptr) {
+	if (p->rows != p->cols) {
+		puts("error: only square patterns can be block triangularized");
+		return 0;
+	}
+
+	size_t n = p->rows;
+	size_t nblocks = 0;
+	size_t* buf = (size_t*)malloc(sizeof(size_t) * (8 * n + 1));
+	bool* on_stack = (bool*)calloc(n + 1, sizeof(bool));
+	if (buf == NULL || on_stack == NULL) {
+		puts("error: insufficient heap memory for block triangularization");
+		free(buf);
+		free(on_stack);
+		return 0;
+	}
+	size_t* match_col = buf;			// column matched to each row
+	size_t* match_row = buf + n;		// row matched to each column
+	size_t* visited = buf + 2 * n;		// last search that reached each column
+	size_t* stack = buf + 3 * n;		// rows on the current search path
+	size_t* next = buf + 4 * n;			// next entry each stacked row will try
+	size_t* via = buf + 5 * n;			// column each stacked row was reached through
+
+	for (size_t i = 0; i < n; i++)
+		match_col[i] = match_row[i] = visited[i] = SIZE_MAX;
+
+	for (size_t r = 0; r < n; r++) {
+
+		// a free column in the row itself is the common case
+		for (size_t k = p->rowptr[r]; k < p->rowptr[r + 1]; k++) {
+			if (match_row[p->colidx[k]] == SIZE_MAX) {
+				match_row[p->colidx[k]] = r;
+				match_col[r] = p->colidx[k];
+				break;
+			}
+		}
+		if (match_col[r] != SIZE_MAX)
+			continue;
+
+		// otherwise look for an augmenting path from r
+		size_t top = 0;
+		stack[0] = r;
+		next[0] = p->rowptr[r];
+		bool found = false;
+		while (!found) {
+			size_t i = stack[top];
+			if (next[top] == p->rowptr[i + 1]) {
+				if (top == 0)
+					break;
+				top--;
+				continue;
+			}
+			size_t c = p->colidx[next[top]++];
+			if (visited[c] == r)
+				continue;
+			visited[c] = r;
+			via[top] = c;
+			if (match_row[c] == SIZE_MAX)
+				found = true;
+			else {
+				top++;
+				stack[top] = match_row[c];
+				next[top] = p->rowptr[stack[top]];
+			}
+		}
+		if (!found) {
+			puts("error: pattern is structurally singular");
+			goto cleanup;
+		}
+		for (size_t l = 0; l <= top; l++) {
+			match_col[stack[l]] = via[l];
+			match_row[via[l]] = stack[l];
+		}
+	}
+
+	// Tarjan's strongly connected components over the rows; each 
+	// component is complete only once everything it depends on is, 
+	// so components come out in the order they can be solved in
+	size_t* index = buf + 2 * n;	// reuses `visited`
+	size_t* low = buf + 6 * n;
+	size_t* scc = buf + 7 * n;		// rows waiting to be assigned a component
+	size_t counter = 0, nscc = 0, placed = 0;
+	for (size_t i = 0; i < n; i++)
+		index[i] = SIZE_MAX;
+
+	for (size_t root = 0; root < n; root++) {
+		if (index[root] != SIZE_MAX)
+			continue;
+
+		size_t top = 0;
+		stack[0] = root;
+		next[0] = p->rowptr[root];
+		index[root] = low[root] = counter++;
+		scc[nscc++] = root;
+		on_stack[root] = true;
+
+		while (true) {
+			size_t i = stack[top];
+			if (next[top] < p->rowptr[i + 1]) {
+				size_t j = match_row[p->colidx[next[top]++]];
+				if (j == i)
+					continue;
+				if (index[j] == SIZE_MAX) {
+					top++;
+					stack[top] = j;
+					next[top] = p->rowptr[j];
+					index[j] = low[j] = counter++;
+					scc[nscc++] = j;
+					on_stack[j] = true;
+				}
+				else if (on_stack[j] && index[j] < low[i])
+					low[i] = index[j];
+				continue;
+			}
+
+			// row i is finished; it closes a component if it is its root
+			if (low[i] == index[i]) {
+				blockptr[nblocks++] = placed;
+				size_t j;
+				do {
+					j = scc[--nscc];
+					on_stack[j] = false;
+					rowperm[placed] = j;
+					colperm[placed] = match_col[j];
+					placed++;
+				} while (j != i);
+			}
+			if (top == 0)
+				break;
+			top--;
+			if (low[i] < low[stack[top]])
+				low[stack[top]] = low[i];
+		}
+	}
+	blockptr[nblocks] = n;
+
+cleanup:
+	free(buf);
+	free(on_stack);
+	return nblocks;
+}
@@ -1,21 +1,29 @@
 #pragma once
 #include <stdlib.h>
+#include <stdbool.h>
+#include "threadpool.h"
+#include "precision.h"
 
-#define mac(x, j, i) x->data[j]->data[i]
+#define CLINALG_ALIGN 64
+
+#define mac(x, j, i) (x)->data[(j) * (x)->stride + (i)]
 
 typedef struct {
 	size_t len;
-	long double data[];
+	scalar* data;
 } rowvec;
 
 typedef struct {
 	size_t rows;
 	size_t cols;
-	rowvec* data[];
+	size_t stride;
+	scalar* data;
 } matrix;
 
 rowvec* new_rowvec(size_t len);
 
+size_t __row_stride(size_t cols);
+
 void destroy_matrix(matrix* m);
 
 matrix* new_matrix(size_t rows, size_t cols);
@@ -24,41 +32,160 @@ matrix* new_nxn(size_t n);
 
 matrix* identity(size_t n);
 
-void row_add(rowvec* a, rowvec* b, long double coef);
+rowvec row_view(matrix* m, size_t j);
+
+void row_axpy_f(float* a, const float* b, float coef, size_t n);
+void row_scale_f(float* a, float coef, size_t n);
+void row_axpy_d(double* a, const double* b, double coef, size_t n);
+void row_scale_d(double* a, double coef, size_t n);
+void row_axpy_ld(long double* a, const long double* b, long double coef, size_t n);
+void row_scale_ld(long double* a, long double coef, size_t n);
+
+void row_add(rowvec* a, rowvec* b, scalar coef);
 
 void print_rowvec(rowvec* r);
 
 void print_matrix(matrix* m);
 
-typedef struct {
-	size_t len;
-	long double* data[];
-} pvec;
-
 typedef struct {
 	size_t rows;
 	size_t cols;
-	pvec* data[];
+	size_t split;
+	size_t stride[2];
+	scalar* data[2];
 } ptrix;
 
+#define pac(p, j, i) (*((i) < (p)->split \
+	? &(p)->data[0][(j) * (p)->stride[0] + (i)] \
+	: &(p)->data[1][(j) * (p)->stride[1] + (i) - (p)->split]))
+
 ptrix* __from_matrix(matrix* m);
 
 ptrix* __augment(matrix* a, matrix* b);
 
 void destroy_ptrix(ptrix* p);
 
-void __pvec_add(pvec* a, pvec* b, long double coef);
+void __ptrix_row_add(ptrix* p, size_t dst, size_t src, scalar coef, size_t from);
+
+void __ptrix_row_scale(ptrix* p, size_t j, scalar coef, size_t from);
+
+void __ptrix_row_swap(ptrix* p, size_t a, size_t b);
 
-void print_pvec(pvec* p);
+size_t __pivot_row(ptrix* p, size_t o);
 
 void print_ptrix(ptrix* p);
 
+typedef enum {
+	ELIM_FORWARD,
+	ELIM_BACKWARD,
+	ELIM_SCALE,
+	ELIM_DONE
+} elim_phase;
+
+typedef struct {
+	ptrix* p;
+	elim_phase phase;
+	size_t pivot;
+} elimination;
+
+extern size_t clinalg_threads;
+
+void __parallel_rows(pool_task task, void* arg, size_t lo, size_t hi, size_t work);
+
+void __eliminate_rows(void* arg, size_t lo, size_t hi);
+
+void __eliminate_below(ptrix* p, size_t o);
+
+void __eliminate_above(ptrix* p, size_t o);
+
 void __right_triangular(ptrix* p, size_t o);
 
 void __left_triangular(ptrix* p, size_t o);
 
+void __scale_rows(void* arg, size_t lo, size_t hi);
+
 void __scale_diagonal(ptrix* p);
 
+elimination begin_elimination(ptrix* p);
+
+bool continue_elimination(elimination* e, size_t budget);
+
+extern size_t clinalg_tile_size;
+
+void __panel_update(scalar* base, size_t stride, size_t c_lo, size_t c_hi,
+	scalar* l, size_t ldl, size_t k0, size_t w, size_t r_lo, size_t r_hi, size_t tile);
+
+void __ptrix_panel_update(ptrix* p, size_t from, scalar* l, size_t ldl,
+	size_t k0, size_t w, size_t r_lo, size_t r_hi, size_t tile);
+
+void __panel_rows(void* arg, size_t lo, size_t hi);
+
+bool __reduce_ptrix_blocked(ptrix* p, size_t nb);
+
 void reduce_ptrix(ptrix* p);
 
-matrix* invert(matrix* m);
\ No newline at end of file
+matrix* invert(matrix* m);
+
+typedef struct {
+	size_t n;
+	matrix* lu;
+	size_t perm[];
+} lu_factors;
+
+matrix* copy_matrix(matrix* m);
+
+void destroy_lu(lu_factors* f);
+
+lu_factors* lu_decompose(matrix* m);
+
+void __lu_substitute(lu_factors* f, const scalar* b, scalar* x);
+
+rowvec* lu_solve(lu_factors* f, rowvec* b);
+
+matrix* lu_inverse(lu_factors* f);
+
+typedef struct {
+	size_t rows;
+	size_t cols;
+	size_t nnz;
+	size_t* rowptr;
+	size_t* colidx;
+	scalar* vals;
+} csr_matrix;
+
+csr_matrix* new_csr(size_t rows, size_t cols, size_t nnz);
+
+void destroy_csr(csr_matrix* m);
+
+csr_matrix* csr_like(csr_matrix* m);
+
+matrix* csr_to_dense(csr_matrix* m);
+
+void print_csr(csr_matrix* m);
+
+typedef struct {
+	size_t n;
+	size_t* prow;
+	size_t* pcol;
+	size_t* lptr;
+	size_t* lrow;
+	size_t* uptr;
+	size_t* ucol;
+	scalar* diag;
+	scalar* lval;
+	scalar* uval;
+} sparse_lu;
+
+void destroy_sparse_lu(sparse_lu* f);
+
+extern scalar clinalg_pivot_threshold;
+
+sparse_lu* sparse_lu_decompose(csr_matrix* a);
+
+void __sparse_lu_substitute(sparse_lu* f, const scalar* b, scalar* x, scalar* work);
+
+rowvec* sparse_lu_solve(sparse_lu* f, rowvec* b);
+
+size_t csr_color_columns(csr_matrix* p, size_t* color);
+
+size_t csr_block_triangularize(csr_matrix* p, size_t* rowperm, size_t* colperm, size_t* blockptr);
@@ -1,5 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "precision.h"
 
 struct __snode {
 	struct __snode* next;
@@ -158,7 +161,7 @@ void destroy_doubly_linked_list(DoublyLinkedList* d) {
 }
 
 DoublyLinkedList* copy_doubly_linked_list(DoublyLinkedList* d) {
-	
+
 	DoublyLinkedList* res = new_doubly_linked_list();
 	if (!res)
 		return NULL;
@@ -172,12 +175,12 @@ DoublyLinkedList* copy_doubly_linked_list(DoublyLinkedList* d) {
 struct __ldnode {
 	struct __ldnode* next;
 	struct __ldnode* prev;
-	long double data;
+	scalar data;
 };
 
 typedef struct __ldnode ldnode;
 
-ldnode* __new_ldnode(long double value) {
+ldnode* __new_ldnode(scalar value) {
 	ldnode* n = (ldnode*)malloc(sizeof(ldnode));
 	if (n != NULL) {
 		n->next = NULL;
@@ -188,9 +191,9 @@ ldnode* __new_ldnode(long double value) {
 }
 
 /*
-Pushes a new long double value onto the doubly linked list.
+Pushes a new scalar value onto the doubly linked list.
 */
-void push_to_doubly_linked_list_ld(DoublyLinkedList* d, long double value) {
+void push_to_doubly_linked_list_ld(DoublyLinkedList* d, scalar value) {
 	snode* n = __new_ldnode(value);
 	if (n == NULL) {
 		puts("error: insufficient heap memory for new node");
@@ -210,9 +213,9 @@ void push_to_doubly_linked_list_ld(DoublyLinkedList* d, long double value) {
 }
 
 /*
-Pushes a new long double value to the END of the doubly linked list.
+Pushes a new scalar value to the END of the doubly linked list.
 */
-void push_back_to_doubly_linked_list_ld(DoublyLinkedList* d, long double value) {
+void push_back_to_doubly_linked_list_ld(DoublyLinkedList* d, scalar value) {
 	ldnode* n = __new_ldnode(value);
 	if (n == NULL) {
 		puts("error: insufficient heap memory for new node");
@@ -235,7 +238,7 @@ void push_back_to_doubly_linked_list_ld(DoublyLinkedList* d, long double value)
 /*
 Removes the first item from a doubly linked list, returning its contained value.
 */
-long double pop_from_doubly_linked_list_ld(DoublyLinkedList* d) {
+scalar pop_from_doubly_linked_list_ld(DoublyLinkedList* d) {
 
 	// get the head and move it to the next node
 	ldnode* resnode = d->head;
@@ -244,7 +247,7 @@ long double pop_from_doubly_linked_list_ld(DoublyLinkedList* d) {
 		((ldnode*)d->head)->prev = NULL;
 
 	// get the important data from the node
-	long double res = resnode->data;
+	scalar res = resnode->data;
 
 	// free the node struct pointer and destroy the old data
 	free(resnode);
@@ -256,7 +259,7 @@ long double pop_from_doubly_linked_list_ld(DoublyLinkedList* d) {
 /*
 Removes the last item from a doubly linked list, returning its contained value.
 */
-long double pop_back_from_doubly_linked_list_ld(DoublyLinkedList* d) {
+scalar pop_back_from_doubly_linked_list_ld(DoublyLinkedList* d) {
 
 	// get the head and move it to the next node
 	ldnode* resnode = d->last;
@@ -265,7 +268,7 @@ long double pop_back_from_doubly_linked_list_ld(DoublyLinkedList* d) {
 		((ldnode*)d->last)->next = NULL;
 
 	// get the important data from the node
-	long double res = resnode->data;
+	scalar res = resnode->data;
 
 	// free the node struct pointer and destroy the old data
 	free(resnode);
@@ -281,8 +284,108 @@ void print_doubly_linked_list_ld(DoublyLinkedList* d) {
 	ldnode* node = d->head;
 
 	while (node) {
-		printf("%Lf <=> ", node->data);
+		printf(SCALAR_FMT " <=> ", node->data);
 		node = node->next;
 	}
 	puts("NULL");
-}
\ No newline at end of file
+}
+
+/*
+A growable array of `size`-byte elements stored contiguously in 
+`data`, for when a list is only ever pushed and popped at its back 
+(a stack) or filled at the back and read front to back (a queue). 
+Pushing doubles the capacity when it runs out, so a push is O(1) 
+amortized with no per-element allocation, and a vector that is 
+cleared and refilled stops allocating once it has reached the 
+largest size it is used at.
+*/
+typedef struct {
+	size_t len;
+	size_t cap;
+	size_t size;
+	char* data;
+} vector;
+
+/*
+Element `i` of the vector `v` of `type`s, as an lvalue.
+*/
+#define vector_item(v, type, i) (((type*)(v)->data)[i])
+
+/*
+Constructs a new, empty vector of `size`-byte elements, returning 
+NULL if it fails.
+*/
+vector* new_vector(size_t size) {
+	vector* v = (vector*)malloc(sizeof(vector));
+	if (v == NULL) {
+		puts("error: insufficient heap memory for new vector");
+		return NULL;
+	}
+	*v = (vector){ 0, 0, size, NULL };
+	return v;
+}
+
+/*
+Makes room for at least `cap` elements, returning false if the 
+heap is out of memory (in which case `v` is unchanged).
+*/
+bool vector_reserve(vector* v, size_t cap) {
+	if (cap <= v->cap)
+		return true;
+
+	size_t grown = v->cap ? 2 * v->cap : 16;
+	if (grown < cap)
+		grown = cap;
+	char* data = (char*)realloc(v->data, grown * v->size);
+	if (data == NULL) {
+		puts("error: insufficient heap memory for vector");
+		return false;
+	}
+	v->data = data;
+	v->cap = grown;
+	return true;
+}
+
+/*
+Copies the element at `elem` onto the back of the vector and 
+returns where it now lives, or NULL if the vector couldn't grow.
+*/
+void* vector_push(vector* v, const void* elem) {
+	if (v->len == v->cap && !vector_reserve(v, v->len + 1))
+		return NULL;
+	void* slot = v->data + v->len * v->size;
+	memcpy(slot, elem, v->size);
+	v->len++;
+	return slot;
+}
+
+/*
+Removes the last element of a non-empty vector and returns a 
+pointer to it, valid until the next push.
+*/
+void* vector_pop(vector* v) {
+	v->len--;
+	return v->data + v->len * v->size;
+}
+
+/*
+Returns the last element of the vector, or NULL if it is empty.
+*/
+void* vector_back(vector* v) {
+	return v->len ? v->data + (v->len - 1) * v->size : NULL;
+}
+
+/*
+Empties the vector, keeping its memory for reuse.
+*/
+void clear_vector(vector* v) {
+	v->len = 0;
+}
+
+void destroy_vector(vector* v) {
+	if (v == NULL)
+		return;
+	free(v->data);
+	free(v);
+	v = NULL;
+}
@@ -1,4 +1,6 @@
 #pragma once
+#include <stdbool.h>
+#include "precision.h"
 
 struct __snode {
 	struct __snode* next;
@@ -34,20 +36,42 @@ DoublyLinkedList* copy_doubly_linked_list(DoublyLinkedList* d);
 struct __ldnode {
 	struct __ldnode* next;
 	struct __ldnode* prev;
-	long double data;
+	scalar data;
 };
 
 typedef struct __ldnode ldnode;
 
-ldnode* __new_ldnode(long double value);
+ldnode* __new_ldnode(scalar value);
 
-void push_to_doubly_linked_list_ld(DoublyLinkedList* d, long double value);
+void push_to_doubly_linked_list_ld(DoublyLinkedList* d, scalar value);
 
-void push_back_to_doubly_linked_list_ld(DoublyLinkedList* d, long double value);
+void push_back_to_doubly_linked_list_ld(DoublyLinkedList* d, scalar value);
 
-long double pop_from_doubly_linked_list_ld(DoublyLinkedList* d);
+scalar pop_from_doubly_linked_list_ld(DoublyLinkedList* d);
 
-long double pop_back_from_doubly_linked_list_ld(DoublyLinkedList* d);
+scalar pop_back_from_doubly_linked_list_ld(DoublyLinkedList* d);
 
 void print_doubly_linked_list_ld(DoublyLinkedList* d);
 
+typedef struct {
+	size_t len;
+	size_t cap;
+	size_t size;
+	char* data;
+} vector;
+
+#define vector_item(v, type, i) (((type*)(v)->data)[i])
+
+vector* new_vector(size_t size);
+
+bool vector_reserve(vector* v, size_t cap);
+
+void* vector_push(vector* v, const void* elem);
+
+void* vector_pop(vector* v);
+
+void* vector_back(vector* v);
+
+void clear_vector(vector* v);
+
+void destroy_vector(vector* v);
@@ -0,0 +1,689 @@
+// for MAP_ANONYMOUS from <sys/mman.h> under -std=c11
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "precision.h"
+#include "bytecode.h"
+
+/*
+The native backend only exists for double precision on x86-64,
+and can be left out entirely with -DCLINALG_NO_JIT. Everywhere
+else `jit_program` declines and programs stay on the interpreter.
+*/
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(CLINALG_FLOAT) && !defined(CLINALG_LONG_DOUBLE) && !defined(CLINALG_NO_JIT)
+#define JIT_X64
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+#endif
+
+/*
+Largest stack frame native code may use. Every instruction keeps 
+its value and adjoint in the frame, so a long enough expression 
+would overflow the calling thread's stack; `jit_program` leaves 
+programs that need more on the interpreter.
+*/
+#define JIT_STACK_MAX (256 * 1024)
+
+/*
+Releases the executable mapping of a program's native code. Safe
+to call with NULL.
+*/
+void __jit_unmap(void* code, size_t size) {
+#ifdef JIT_X64
+	if (code == NULL)
+		return;
+#if defined(_WIN32)
+	VirtualFree(code, 0, MEM_RELEASE);
+#else
+	munmap(code, size);
+#endif
+#else
+	(void)code;
+	(void)size;
+#endif
+}
+
+/*
+Whether `jit_program` can produce native code on this platform
+and build.
+*/
+bool jit_supported(void) {
+#ifdef JIT_X64
+	return true;
+#else
+	return false;
+#endif
+}
+
+#ifdef JIT_X64
+
+/*
+Machine code being assembled, grown by doubling. `failed` is set
+once an allocation fails, after which emitting does nothing.
+*/
+typedef struct {
+	uint8_t* data;
+	size_t len;
+	size_t cap;
+	bool failed;
+} jit_buf;
+
+void __jit_emit(jit_buf* b, const void* bytes, size_t n) {
+	if (b->failed)
+		return;
+	if (b->len + n > b->cap) {
+		size_t cap = b->cap ? b->cap * 2 : 4096;
+		while (cap < b->len + n)
+			cap *= 2;
+		uint8_t* data = (uint8_t*)realloc(b->data, cap);
+		if (data == NULL) {
+			b->failed = true;
+			return;
+		}
+		b->data = data;
+		b->cap = cap;
+	}
+	memcpy(b->data + b->len, bytes, n);
+	b->len += n;
+}
+
+void __jit_u8(jit_buf* b, uint8_t v) {
+	__jit_emit(b, &v, 1);
+}
+
+void __jit_u32(jit_buf* b, uint32_t v) {
+	uint8_t le[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+	__jit_emit(b, le, 4);
+}
+
+void __jit_u64(jit_buf* b, uint64_t v) {
+	__jit_u32(b, (uint32_t)v);
+	__jit_u32(b, (uint32_t)(v >> 32));
+}
+
+/*
+Where an SSE operand lives: an xmm register (`disp` is its
+number), the environment (rbx), the frame (rsp), the gradient
+(rax) or the constant pool in front of the code (rip relative,
+`disp` counted from the start of the code).
+*/
+typedef enum {
+	JIT_XMM,
+	JIT_ENV,
+	JIT_FRAME,
+	JIT_RAX,
+	JIT_DATA
+} jit_base;
+
+typedef struct {
+	jit_base base;
+	int32_t disp;
+} jit_loc;
+
+#define SSE_LOAD	0x10	// movsd xmm, m64 (prefix F2)
+#define SSE_STORE	0x11	// movsd m64, xmm
+#define SSE_SQRT	0x51
+#define SSE_ADD		0x58
+#define SSE_MUL		0x59
+#define SSE_SUB		0x5C
+#define SSE_DIV		0x5E
+#define SSE_MOVAPD	0x28	// (prefix 66)
+#define SSE_XORPD	0x57
+#define SSE_UCOMISD	0x2E
+
+/*
+Emits `prefix 0F op` with a ModRM (and SIB) encoding `xmm<reg>`
+and `at`. Only xmm0-xmm7 are used, so no REX prefix is needed.
+*/
+void __jit_sse(jit_buf* b, uint8_t prefix, uint8_t op, unsigned reg, jit_loc at) {
+	uint8_t head[3] = { prefix, 0x0F, op };
+	__jit_emit(b, head, 3);
+	switch (at.base) {
+	case JIT_XMM:
+		__jit_u8(b, (uint8_t)(0xC0 | reg << 3 | at.disp));
+		break;
+	case JIT_ENV:
+		__jit_u8(b, (uint8_t)(0x80 | reg << 3 | 3));
+		__jit_u32(b, (uint32_t)at.disp);
+		break;
+	case JIT_RAX:
+		__jit_u8(b, (uint8_t)(0x80 | reg << 3));
+		__jit_u32(b, (uint32_t)at.disp);
+		break;
+	case JIT_FRAME:
+		__jit_u8(b, (uint8_t)(0x84 | reg << 3));
+		__jit_u8(b, 0x24);
+		__jit_u32(b, (uint32_t)at.disp);
+		break;
+	case JIT_DATA:
+		__jit_u8(b, (uint8_t)(0x05 | reg << 3));
+		__jit_u32(b, (uint32_t)(at.disp - (int32_t)(b->len + 4)));
+		break;
+	}
+}
+
+jit_loc __xmm(int r) {
+	return (jit_loc){ JIT_XMM, r };
+}
+
+void __jit_load(jit_buf* b, unsigned reg, jit_loc at) {
+	__jit_sse(b, 0xF2, SSE_LOAD, reg, at);
+}
+
+void __jit_store(jit_buf* b, jit_loc at, unsigned reg) {
+	__jit_sse(b, 0xF2, SSE_STORE, reg, at);
+}
+
+void __jit_call(jit_buf* b, const void* fn) {
+	uint8_t mov[2] = { 0x48, 0xB8 };	// mov rax, imm64
+	uint8_t call[2] = { 0xFF, 0xD0 };	// call rax
+	__jit_emit(b, mov, 2);
+	__jit_u64(b, (uint64_t)(uintptr_t)fn);
+	__jit_emit(b, call, 2);
+}
+
+/*
+Emits a conditional jump with a placeholder target and returns
+where its displacement is, for `__jit_land` to fill in.
+*/
+size_t __jit_jump(jit_buf* b, uint8_t cc) {
+	uint8_t head[2] = { 0x0F, cc };
+	__jit_emit(b, head, 2);
+	__jit_u32(b, 0);
+	return b->len - 4;
+}
+
+void __jit_land(jit_buf* b, size_t at) {
+	if (b->failed)
+		return;
+	uint32_t rel = (uint32_t)(b->len - (at + 4));
+	for (int i = 0; i < 4; i++)
+		b->data[at + i] = (uint8_t)(rel >> 8 * i);
+}
+
+#define JCC_JE	0x84
+#define JCC_JBE	0x86
+#define JCC_JP	0x8A
+
+/*
+Emits `mov rbx, <first argument>`, reserves `frame` bytes of stack
+(touching every page on the way down, as Windows requires) and,
+for gradients, saves the second argument in the frame at `gp`.
+*/
+void __jit_prologue(jit_buf* b, uint32_t frame, int32_t gp) {
+#if defined(_WIN32)
+	uint8_t head[4] = { 0x53, 0x48, 0x89, 0xCB };	// push rbx; mov rbx, rcx
+	uint8_t save[4] = { 0x48, 0x89, 0x94, 0x24 };	// mov [rsp + disp32], rdx
+#else
+	uint8_t head[4] = { 0x53, 0x48, 0x89, 0xFB };	// push rbx; mov rbx, rdi
+	uint8_t save[4] = { 0x48, 0x89, 0xB4, 0x24 };	// mov [rsp + disp32], rsi
+#endif
+	uint8_t sub[3] = { 0x48, 0x81, 0xEC };
+	uint8_t probe[4] = { 0xC6, 0x04, 0x24, 0x00 };	// mov byte [rsp], 0
+	__jit_emit(b, head, 4);
+	uint32_t left = frame;
+	for (; left > 4096; left -= 4096) {
+		__jit_emit(b, sub, 3);
+		__jit_u32(b, 4096);
+		__jit_emit(b, probe, 4);
+	}
+	__jit_emit(b, sub, 3);
+	__jit_u32(b, left);
+	if (gp >= 0) {
+		__jit_emit(b, save, 4);
+		__jit_u32(b, (uint32_t)gp);
+	}
+}
+
+void __jit_epilogue(jit_buf* b, uint32_t frame) {
+	uint8_t add[3] = { 0x48, 0x81, 0xC4 };
+	uint8_t tail[2] = { 0x5B, 0xC3 };	// pop rbx; ret
+	__jit_emit(b, add, 3);
+	__jit_u32(b, frame);
+	__jit_emit(b, tail, 2);
+}
+
+/*
+libm entry points of the functions, by opcode starting at OP_SIN.
+OP_SQRT is inlined as sqrtsd, which is correctly rounded like
+sqrt itself.
+*/
+double (*__jit_fns[])(double) = {
+	sin, cos, tan, asin, acos, atan, log10, log, sqrt, exp
+};
+
+/*
+The layout both native functions of a program share: the stack
+effect of every instruction, resolved once, and where each value
+lives. Constants and variables are read straight out of the pool
+and the environment; computed values get a frame slot.
+*/
+typedef struct {
+	program* prog;
+	unsigned* lhs;		// instruction that produced the left (only) operand
+	unsigned* rhs;
+	unsigned* user;		// instruction consuming each value
+	size_t data_len;	// bytes of constant pool: consts, then 1, 2 and ln(10)
+	int32_t shadow;		// space a callee may use above rsp (Windows)
+} jit_plan;
+
+jit_loc __jit_val(jit_plan* p, size_t pc) {
+	instruction ins = p->prog->code[pc];
+	if (ins.op == OP_CONST)
+		return (jit_loc){ JIT_DATA, (int32_t)(8 * ins.arg) - (int32_t)p->data_len };
+	if (ins.op == OP_VAR)
+		return (jit_loc){ JIT_ENV, (int32_t)(sizeof(scalar) * ins.arg) };
+	return (jit_loc){ JIT_FRAME, (int32_t)(p->shadow + 8 * pc) };
+}
+
+jit_loc __jit_adj(jit_plan* p, size_t pc) {
+	return (jit_loc){ JIT_FRAME, (int32_t)(p->shadow + 8 * (p->prog->len + pc)) };
+}
+
+jit_loc __jit_temp(jit_plan* p) {
+	return (jit_loc){ JIT_FRAME, (int32_t)(p->shadow + 8 * 2 * p->prog->len) };
+}
+
+jit_loc __jit_data(jit_plan* p, size_t k) {
+	return (jit_loc){ JIT_DATA, (int32_t)(8 * (p->prog->nconsts + k)) - (int32_t)p->data_len };
+}
+
+size_t __jit_frame(jit_plan* p) {
+	return __align_up((size_t)p->shadow + 8 * (2 * p->prog->len + 2), 16);
+}
+
+/*
+Emits one forward step: computes instruction `pc` into xmm0.
+`held` is the instruction whose value xmm0 already holds (if it
+wasn't stored, it is one of this instruction's operands).
+*/
+void __jit_forward(jit_buf* b, jit_plan* p, size_t pc, size_t held) {
+	unsigned op = p->prog->code[pc].op;
+	size_t l = p->lhs[pc], r = p->rhs[pc];
+
+	if (op > OP_POW) {
+		if (held != l)
+			__jit_load(b, 0, __jit_val(p, l));
+		if (op == OP_SQRT)
+			__jit_sse(b, 0xF2, SSE_SQRT, 0, __xmm(0));
+		else
+			__jit_call(b, (const void*)__jit_fns[op - OP_SIN]);
+		return;
+	}
+
+	static const uint8_t sse[] = { SSE_ADD, SSE_SUB, SSE_MUL, SSE_DIV };
+	if (held == r && (op == OP_ADD || op == OP_MUL)) {
+		__jit_sse(b, 0xF2, sse[op - OP_ADD], 0, __jit_val(p, l));
+		return;
+	}
+	if (held == r) {
+		__jit_sse(b, 0x66, SSE_MOVAPD, 1, __xmm(0));
+		__jit_load(b, 0, __jit_val(p, l));
+	}
+	else {
+		if (held != l)
+			__jit_load(b, 0, __jit_val(p, l));
+		if (op == OP_POW)
+			__jit_load(b, 1, __jit_val(p, r));
+	}
+
+	if (op == OP_POW)
+		__jit_call(b, (const void*)pow);
+	else
+		__jit_sse(b, 0xF2, sse[op - OP_ADD], 0, held == r ? __xmm(1) : __jit_val(p, r));
+}
+
+/*
+Emits the whole forward sweep. The value function keeps a result
+in xmm0 when the very next code consumes it; the gradient
+function stores every value, since the reverse sweep reads them.
+*/
+void __jit_forward_sweep(jit_buf* b, jit_plan* p, bool keep_all) {
+	program* prog = p->prog;
+	size_t held = SIZE_MAX;
+
+	for (size_t pc = 0; pc < prog->len; pc++) {
+		if (prog->code[pc].op < OP_ADD)
+			continue;
+		__jit_forward(b, p, pc, held);
+		held = pc;
+
+		size_t next = pc + 1;
+		while (next < prog->len && prog->code[next].op < OP_ADD)
+			next++;
+		if (keep_all || (next != prog->len && p->user[pc] != next))
+			__jit_store(b, __jit_val(p, pc), 0);
+	}
+}
+
+/*
+Adds xmm0 to (or subtracts it from) the adjoint of instruction `pc`.
+*/
+void __jit_accumulate(jit_buf* b, jit_plan* p, size_t pc, bool subtract) {
+	if (subtract) {
+		__jit_sse(b, 0x66, SSE_MOVAPD, 1, __xmm(0));
+		__jit_load(b, 0, __jit_adj(p, pc));
+		__jit_sse(b, 0xF2, SSE_SUB, 0, __xmm(1));
+	}
+	else
+		__jit_sse(b, 0xF2, SSE_ADD, 0, __jit_adj(p, pc));
+	__jit_store(b, __jit_adj(p, pc), 0);
+}
+
+/*
+Emits one reverse step of instruction `pc`, mirroring
+`run_program_gradient` operation for operation so both produce
+the same bits.
+*/
+void __jit_reverse(jit_buf* b, jit_plan* p, size_t pc) {
+	instruction ins = p->prog->code[pc];
+	jit_loc a = __jit_adj(p, pc), t = __jit_temp(p);
+	jit_loc v = __jit_val(p, pc), x, y;
+
+	if (ins.op == OP_CONST)
+		return;
+	if (ins.op == OP_VAR) {
+		uint8_t grad[4] = { 0x48, 0x8B, 0x84, 0x24 };	// mov rax, [rsp + disp32]
+		jit_loc g = { JIT_RAX, (int32_t)(sizeof(scalar) * ins.arg) };
+		__jit_emit(b, grad, 4);
+		__jit_u32(b, (uint32_t)(p->shadow + 8 * (2 * p->prog->len + 1)));
+		__jit_load(b, 0, a);
+		__jit_sse(b, 0xF2, SSE_ADD, 0, g);
+		__jit_store(b, g, 0);
+		return;
+	}
+
+	size_t l = p->lhs[pc], r = p->rhs[pc];
+	x = __jit_val(p, l);
+	y = ins.op <= OP_POW ? __jit_val(p, r) : x;
+
+	// skip if the adjoint is exactly 0 (but not NaN)
+	__jit_load(b, 0, a);
+	__jit_sse(b, 0x66, SSE_XORPD, 1, __xmm(1));
+	__jit_sse(b, 0x66, SSE_UCOMISD, 0, __xmm(1));
+	size_t nan = __jit_jump(b, JCC_JP);
+	size_t zero = __jit_jump(b, JCC_JE);
+	__jit_land(b, nan);
+
+	switch (ins.op) {
+	case OP_ADD:
+	case OP_SUB:
+		__jit_accumulate(b, p, l, false);
+		__jit_load(b, 0, a);
+		__jit_accumulate(b, p, r, ins.op == OP_SUB);
+		break;
+	case OP_MUL:
+		__jit_sse(b, 0xF2, SSE_MUL, 0, y);
+		__jit_accumulate(b, p, l, false);
+		__jit_load(b, 0, a);
+		__jit_sse(b, 0xF2, SSE_MUL, 0, x);
+		__jit_accumulate(b, p, r, false);
+		break;
+	case OP_DIV:
+		__jit_sse(b, 0xF2, SSE_DIV, 0, y);
+		__jit_accumulate(b, p, l, false);
+		__jit_load(b, 1, y);
+		__jit_sse(b, 0xF2, SSE_MUL, 1, y);
+		__jit_load(b, 0, a);
+		__jit_sse(b, 0xF2, SSE_MUL, 0, x);
+		__jit_sse(b, 0xF2, SSE_DIV, 0, __xmm(1));
+		__jit_accumulate(b, p, r, true);
+		break;
+	case OP_POW: {
+		__jit_load(b, 0, x);
+		__jit_load(b, 1, y);
+		__jit_sse(b, 0xF2, SSE_SUB, 1, __jit_data(p, 0));
+		__jit_call(b, (const void*)pow);
+		__jit_store(b, t, 0);
+		__jit_load(b, 0, a);
+		__jit_sse(b, 0xF2, SSE_MUL, 0, y);
+		__jit_sse(b, 0xF2, SSE_MUL, 0, t);
+		__jit_accumulate(b, p, l, false);
+
+		// the exponent's partial only exists for a positive base
+		__jit_load(b, 0, x);
+		__jit_sse(b, 0x66, SSE_XORPD, 1, __xmm(1));
+		__jit_sse(b, 0x66, SSE_UCOMISD, 0, __xmm(1));
+		size_t nonpositive = __jit_jump(b, JCC_JBE);
+		__jit_call(b, (const void*)log);
+		__jit_store(b, t, 0);
+		__jit_load(b, 0, a);
+		__jit_sse(b, 0xF2, SSE_MUL, 0, v);
+		__jit_sse(b, 0xF2, SSE_MUL, 0, t);
+		__jit_accumulate(b, p, r, false);
+		__jit_land(b, nonpositive);
+		break;
+	}
+	case OP_SIN:
+	case OP_COS:
+		__jit_load(b, 0, x);
+		__jit_call(b, (const void*)(ins.op == OP_SIN ? cos : sin));
+		__jit_sse(b, 0xF2, SSE_MUL, 0, a);
+		__jit_accumulate(b, p, l, ins.op == OP_COS);
+		break;
+	case OP_TAN:
+		__jit_load(b, 0, x);
+		__jit_call(b, (const void*)cos);
+		__jit_sse(b, 0xF2, SSE_MUL, 0, __xmm(0));
+		__jit_sse(b, 0x66, SSE_MOVAPD, 1, __xmm(0));
+		__jit_load(b, 0, a);
+		__jit_sse(b, 0xF2, SSE_DIV, 0, __xmm(1));
+		__jit_accumulate(b, p, l, false);
+		break;
+	case OP_ASIN:
+	case OP_ACOS:
+		__jit_load(b, 1, x);
+		__jit_sse(b, 0xF2, SSE_MUL, 1, x);
+		__jit_load(b, 0, __jit_data(p, 0));
+		__jit_sse(b, 0xF2, SSE_SUB, 0, __xmm(1));
+		__jit_sse(b, 0xF2, SSE_SQRT, 1, __xmm(0));
+		__jit_load(b, 0, a);
+		__jit_sse(b, 0xF2, SSE_DIV, 0, __xmm(1));
+		__jit_accumulate(b, p, l, ins.op == OP_ACOS);
+		break;
+	case OP_ATAN:
+		__jit_load(b, 1, x);
+		__jit_sse(b, 0xF2, SSE_MUL, 1, x);
+		__jit_sse(b, 0xF2, SSE_ADD, 1, __jit_data(p, 0));
+		__jit_sse(b, 0xF2, SSE_DIV, 0, __xmm(1));
+		__jit_accumulate(b, p, l, false);
+		break;
+	case OP_LOG10:
+		__jit_load(b, 1, x);
+		__jit_sse(b, 0xF2, SSE_MUL, 1, __jit_data(p, 2));
+		__jit_sse(b, 0xF2, SSE_DIV, 0, __xmm(1));
+		__jit_accumulate(b, p, l, false);
+		break;
+	case OP_LN:
+		__jit_sse(b, 0xF2, SSE_DIV, 0, x);
+		__jit_accumulate(b, p, l, false);
+		break;
+	case OP_SQRT:
+		__jit_load(b, 1, __jit_data(p, 1));
+		__jit_sse(b, 0xF2, SSE_MUL, 1, v);
+		__jit_sse(b, 0xF2, SSE_DIV, 0, __xmm(1));
+		__jit_accumulate(b, p, l, false);
+		break;
+	case OP_EXP:
+		__jit_sse(b, 0xF2, SSE_MUL, 0, v);
+		__jit_accumulate(b, p, l, false);
+		break;
+	}
+	__jit_land(b, zero);
+}
+
+/*
+Emits `scalar fn(const scalar* env)`.
+*/
+void __jit_value_fn(jit_buf* b, jit_plan* p) {
+	uint32_t frame = (uint32_t)__jit_frame(p);
+	__jit_prologue(b, frame, -1);
+	__jit_forward_sweep(b, p, false);
+	size_t last = p->prog->len - 1;
+	if (p->prog->code[last].op < OP_ADD)
+		__jit_load(b, 0, __jit_val(p, last));
+	__jit_epilogue(b, frame);
+}
+
+/*
+Emits `scalar fn(const scalar* env, scalar* grad)`, the native
+counterpart of `run_program_gradient` with a contiguous
+environment: a forward sweep storing every value, then the
+reverse sweep, unrolled.
+*/
+void __jit_gradient_fn(jit_buf* b, jit_plan* p) {
+	program* prog = p->prog;
+	uint32_t frame = (uint32_t)__jit_frame(p);
+	int32_t gp = (int32_t)(p->shadow + 8 * (2 * prog->len + 1));
+	__jit_prologue(b, frame, gp);
+	__jit_forward_sweep(b, p, true);
+
+	uint8_t grad[4] = { 0x48, 0x8B, 0x84, 0x24 };	// mov rax, [rsp + disp32]
+	__jit_emit(b, grad, 4);
+	__jit_u32(b, (uint32_t)gp);
+	__jit_sse(b, 0x66, SSE_XORPD, 0, __xmm(0));
+	for (size_t i = 0; i < prog->nvars; i++)
+		__jit_store(b, (jit_loc){ JIT_RAX, (int32_t)(sizeof(scalar) * i) }, 0);
+	for (size_t pc = 0; pc + 1 < prog->len; pc++)
+		__jit_store(b, __jit_adj(p, pc), 0);
+	__jit_load(b, 0, __jit_data(p, 0));
+	__jit_store(b, __jit_adj(p, prog->len - 1), 0);
+
+	for (size_t pc = prog->len; pc-- > 0;)
+		__jit_reverse(b, p, pc);
+
+	__jit_load(b, 0, __jit_val(p, prog->len - 1));
+	__jit_epilogue(b, frame);
+}
+
+#endif
+
+/*
+Compiles a program to native x86-64 code and caches it on the
+program: from then on `run_program` and `run_program_gradient`
+(with a contiguous environment) call straight into it, and
+`destroy_program` releases it. The code is assembled in memory
+and copied into a fresh page that is then made executable (and no
+longer writable), so no external compiler is involved. Unlike the
+interpreter's gradient, the native one keeps its scratch on the
+machine stack and is safe to run from several threads at once.
+
+Returns true if the program has native code (compiling it now if
+needed), or false if this platform or build has no JIT (see
+`jit_supported`), the program's frame would exceed `JIT_STACK_MAX`
+or compilation failed, in which case the program keeps running on
+the interpreter.
+*/
+bool jit_program(program* prog) {
+#ifdef JIT_X64
+	if (prog->native != NULL)
+		return true;
+	if (prog->len == 0)
+		return false;
+
+	jit_plan p = { prog, NULL, NULL, NULL, __align_up(sizeof(scalar) * (prog->nconsts + 3), 16), 0 };
+#if defined(_WIN32)
+	p.shadow = 32;
+#endif
+	if (__jit_frame(&p) > JIT_STACK_MAX)
+		return false;
+	p.lhs = (unsigned*)calloc(3 * prog->len, sizeof(unsigned));
+	if (p.lhs == NULL)
+		return false;
+	p.rhs = p.lhs + prog->len;
+	p.user = p.rhs + prog->len;
+
+	// resolve the stack: which instruction produced each operand
+	unsigned producers[PROGRAM_STACK_MAX];
+	size_t top = 0;
+	for (size_t pc = 0; pc < prog->len; pc++) {
+		unsigned op = prog->code[pc].op;
+		if (op >= OP_ADD && op <= OP_POW) {
+			p.rhs[pc] = producers[--top];
+			p.user[p.rhs[pc]] = (unsigned)pc;
+		}
+		if (op >= OP_ADD) {
+			p.lhs[pc] = producers[--top];
+			p.user[p.lhs[pc]] = (unsigned)pc;
+		}
+		producers[top++] = (unsigned)pc;
+	}
+
+	jit_buf b = { NULL, 0, 0, false };
+	for (size_t k = 0; k < prog->nconsts; k++)
+		__jit_emit(&b, &prog->consts[k], sizeof(scalar));
+	scalar extra[3] = { 1, 2, smath(log)((scalar)10) };
+	__jit_emit(&b, extra, sizeof(extra));
+	while (b.len < p.data_len && !b.failed)
+		__jit_u8(&b, 0xCC);
+
+	// displacements into the pool are relative to the code
+	size_t data_len = b.len;
+	jit_buf code = { NULL, 0, 0, false };
+	__jit_value_fn(&code, &p);
+	while (code.len % 16 && !code.failed)
+		__jit_u8(&code, 0xCC);
+	size_t grad_at = code.len;
+	__jit_gradient_fn(&code, &p);
+	free(p.lhs);
+
+	if (code.failed || b.failed) {
+		free(code.data);
+		free(b.data);
+		return false;
+	}
+	__jit_emit(&b, code.data, code.len);
+	free(code.data);
+	if (b.failed) {
+		free(b.data);
+		return false;
+	}
+
+#if defined(_WIN32)
+	void* page = VirtualAlloc(NULL, b.len, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	bool mapped = page != NULL;
+#else
+	void* page = mmap(NULL, b.len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	bool mapped = page != MAP_FAILED;
+#endif
+	if (!mapped) {
+		puts("error: can't map memory for native code");
+		free(b.data);
+		return false;
+	}
+	memcpy(page, b.data, b.len);
+	free(b.data);
+
+#if defined(_WIN32)
+	DWORD old;
+	bool sealed = VirtualProtect(page, b.len, PAGE_EXECUTE_READ, &old);
+	FlushInstructionCache(GetCurrentProcess(), page, b.len);
+#else
+	bool sealed = mprotect(page, b.len, PROT_READ | PROT_EXEC) == 0;
+#endif
+	if (!sealed) {
+		puts("error: can't make native code executable");
+		__jit_unmap(page, b.len);
+		return false;
+	}
+
+	prog->native_code = page;
+	prog->native_size = b.len;
+	prog->native = (native_eval)((char*)page + data_len);
+	prog->native_gradient = (native_gradient)((char*)page + data_len + grad_at);
+	return true;
+#else
+	(void)prog;
+	return false;
+#endif
+}
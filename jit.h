@@ -0,0 +1,13 @@
+#pragma once
+#include <stdlib.h>
+#include <stdbool.h>
+#include "precision.h"
+#include "bytecode.h"
+
+#define JIT_STACK_MAX (256 * 1024)
+
+bool jit_supported(void);
+
+bool jit_program(program* prog);
+
+void __jit_unmap(void* code, size_t size);
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include "precision.h"
+#include "bytecode.h"
+#include "stringmanip.h"
+
+typedef enum {
+	TOKEN_END,
+	TOKEN_NUMBER,
+	TOKEN_IDENT,
+	TOKEN_OPERATOR,
+	TOKEN_FUNCTION,
+	TOKEN_LPAREN,
+	TOKEN_RPAREN,
+	TOKEN_COMMA
+} token_kind;
+
+/*
+One token of an expression, classified once as it is read so that 
+no later stage has to look at its spelling again. `op` is the 
+token's opcode for operators and functions, `value` is the parsed 
+value of a number, and `name` is the interned id (see `intern`) of 
+an identifier. Fields a kind doesn't use are 0.
+*/
+typedef struct {
+	token_kind kind;
+	unsigned op;
+	scalar value;
+	size_t name;
+} token;
+
+extern const char* __op_names[];
+
+/*
+Returns whether `c` ends an identifier: whitespace, the end of the 
+string, or a character that is a token on its own.
+*/
+bool __lex_delimiter(char c) {
+	switch (c) {
+	case '\0': case '(': case ')': case ',':
+	case '+': case '-': case '*': case '/': case '^':
+		return true;
+	default:
+		return isspace((unsigned char)c);
+	}
+}
+
+/*
+Reads the token at `at`, skipping any whitespace before it, into 
+`tok` and returns where the token after it starts. At the end of 
+the string the token is TOKEN_END and `at` is returned as is, so 
+an expression is lexed in one pass by calling this until then. 
+Identifiers are interned as they are read; if that fails the 
+token's `name` is SIZE_MAX.
+
+A number is anything `strtoscalar` reads starting from a digit or 
+a '.'; a name made of anything else up to the next delimiter is a 
+function if it spells one of the function opcodes and an 
+identifier otherwise.
+*/
+const char* lex_token(const char* at, token* tok) {
+	while (isspace((unsigned char)*at))
+		at++;
+
+	*tok = (token){ TOKEN_END, 0, 0, 0 };
+	switch (*at) {
+	case '\0':									return at;
+	case '(':	tok->kind = TOKEN_LPAREN;		return at + 1;
+	case ')':	tok->kind = TOKEN_RPAREN;		return at + 1;
+	case ',':	tok->kind = TOKEN_COMMA;		return at + 1;
+	case '+':	tok->op = OP_ADD;	break;
+	case '-':	tok->op = OP_SUB;	break;
+	case '*':	tok->op = OP_MUL;	break;
+	case '/':	tok->op = OP_DIV;	break;
+	case '^':	tok->op = OP_POW;	break;
+	}
+	if (tok->op) {
+		tok->kind = TOKEN_OPERATOR;
+		return at + 1;
+	}
+
+	if (isdigit((unsigned char)*at) || *at == '.') {
+		char* end = NULL;
+		tok->value = strtoscalar(at, &end);
+		if (end != at) {
+			tok->kind = TOKEN_NUMBER;
+			return end;
+		}
+	}
+
+	const char* end = at;
+	while (!__lex_delimiter(*end))
+		end++;
+	size_t len = end - at;
+
+	for (unsigned op = OP_SIN; op <= OP_EXP; op++) {
+		const char* name = __op_names[op - OP_ADD];
+		if (strlen(name) == len && memcmp(name, at, len) == 0) {
+			tok->kind = TOKEN_FUNCTION;
+			tok->op = op;
+			return end;
+		}
+	}
+
+	tok->kind = TOKEN_IDENT;
+	tok->name = intern_n(at, len);
+	return end;
+}
+
+/*
+Prints a token's spelling to stdout.
+*/
+void print_token(const token* tok) {
+	switch (tok->kind) {
+	case TOKEN_NUMBER:		printf(SCALAR_FMT, tok->value);				break;
+	case TOKEN_IDENT:		printf("%s", interned_name(tok->name));		break;
+	case TOKEN_OPERATOR:
+	case TOKEN_FUNCTION:	printf("%s", __op_names[tok->op - OP_ADD]);	break;
+	case TOKEN_LPAREN:		printf("(");								break;
+	case TOKEN_RPAREN:		printf(")");								break;
+	case TOKEN_COMMA:		printf(",");								break;
+	case TOKEN_END:														break;
+	}
+}
+
+/*
+Prints a vector of tokens from first to last.
+*/
+void print_tokens(vector* tokens) {
+	for (size_t i = 0; i < tokens->len; i++) {
+		print_token(&vector_item(tokens, token, i));
+		printf(" <=> ");
+	}
+	puts("NULL");
+}
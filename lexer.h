@@ -0,0 +1,31 @@
+#pragma once
+#include <stdlib.h>
+#include <stdbool.h>
+#include "precision.h"
+#include "dlinklist.h"
+
+typedef enum {
+	TOKEN_END,
+	TOKEN_NUMBER,
+	TOKEN_IDENT,
+	TOKEN_OPERATOR,
+	TOKEN_FUNCTION,
+	TOKEN_LPAREN,
+	TOKEN_RPAREN,
+	TOKEN_COMMA
+} token_kind;
+
+typedef struct {
+	token_kind kind;
+	unsigned op;
+	scalar value;
+	size_t name;
+} token;
+
+bool __lex_delimiter(char c);
+
+const char* lex_token(const char* at, token* tok);
+
+void print_token(const token* tok);
+
+void print_tokens(vector* tokens);
@@ -2,6 +2,7 @@
 #include "stupidmath.h"
 #include "clinalg.h"
 #include "shunting.h"
+#include "solver.h"
 
 void sub(void) {
 	char expr2[] = "i+j=4";
@@ -24,14 +25,29 @@ int main(void) {
 
 	char expr1[] = "i-j=9";
 	
-	DoublyLinkedList* d = shunting_yard(words(functionify(expr1)));
+	vector* d = shunting_yard(words(functionify(expr1)));
 
 	varmap* vm = vars(d);
 
-	long double err = __remaining_soln_error(d, vm),
+	scalar err = __remaining_soln_error(d, vm),
 		dydx = ddx(d, vm, "j");
 
-	printf("%Lf\n%Lf\n", err, dydx);
+	printf(SCALAR_FMT "\n" SCALAR_FMT "\n", err, dydx);
+
+	char eq1[] = "i-j=9", eq2[] = "i+j=4";
+
+	DoublyLinkedList* sys = new_doubly_linked_list();
+	push_back_to_doubly_linked_list(sys, eq1);
+	push_back_to_doubly_linked_list(sys, eq2);
+
+	newton_stats stats;
+	varmap* soln = solve_system(sys, NULL, NULL, &stats);
+	if (soln) {
+		printf("solved in %zu iterations:\n", stats.iter);
+		print_varmap(soln);
+		free(soln);
+	}
+	destroy_doubly_linked_list(sys);
 
 	return 0;
 }
\ No newline at end of file
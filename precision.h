@@ -0,0 +1,46 @@
+#pragma once
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+/*
+The scalar type every matrix, variable and expression value is 
+stored and computed in, picked at compile time:
+
+	(default)				double
+	-DCLINALG_FLOAT			float
+	-DCLINALG_LONG_DOUBLE	long double (high precision, x87 on x86-64)
+
+`smath(sin)` names the libm function for the chosen type, 
+`strtoscalar` parses one, `SCALAR_FMT` prints one and 
+`SCALAR_EPSILON` is its machine epsilon. Kernels 
+that exist in a typed variant per scalar type (see 
+`DEFINE_ROW_KERNELS` in clinalg.c) are reached through 
+`scalar_fn(name)`, which appends the type's suffix.
+*/
+#if defined(CLINALG_LONG_DOUBLE)
+typedef long double scalar;
+#define SCALAR_SUFFIX ld
+#define SCALAR_FMT "%Lf"
+#define SCALAR_EPSILON LDBL_EPSILON
+#define strtoscalar strtold
+#define smath(fn) fn##l
+#elif defined(CLINALG_FLOAT)
+typedef float scalar;
+#define SCALAR_SUFFIX f
+#define SCALAR_FMT "%f"
+#define SCALAR_EPSILON FLT_EPSILON
+#define strtoscalar strtof
+#define smath(fn) fn##f
+#else
+typedef double scalar;
+#define SCALAR_SUFFIX d
+#define SCALAR_FMT "%f"
+#define SCALAR_EPSILON DBL_EPSILON
+#define strtoscalar strtod
+#define smath(fn) fn
+#endif
+
+#define __scalar_glue2(name, suffix) name##_##suffix
+#define __scalar_glue(name, suffix) __scalar_glue2(name, suffix)
+#define scalar_fn(name) __scalar_glue(name, SCALAR_SUFFIX)
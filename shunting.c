@@ -2,37 +2,43 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include "dlinklist.h"
+#include "precision.h"
+#include "lexer.h"
 #include "stringmanip.h"
+#include "bytecode.h"
 
 /*
-Returns a doubly linked list of the substrings 
-delimited by spaces in a given string.
+Appends the tokens of a given expression to `tokens`, read 
+in one pass by `lex_token`. Returns false if the vector 
+couldn't grow or a name couldn't be interned. `expr` isn't 
+referenced once this returns.
 */
-DoublyLinkedList* words(char* expr) {
-	DoublyLinkedList* res = new_doubly_linked_list();
+bool words_into(vector* tokens, char* expr) {
+	token tok;
+	for (const char* at = lex_token(expr, &tok); tok.kind != TOKEN_END; at = lex_token(at, &tok)) {
+		if (tok.kind == TOKEN_IDENT && tok.name == SIZE_MAX)
+			return false;
+		if (!vector_push(tokens, &tok))
+			return false;
+	}
+	return true;
+}
+
+/*
+Returns a new vector of the tokens of a given expression.
+*/
+vector* words(char* expr) {
+	vector* res = new_vector(sizeof(token));
 	if (res == NULL)
 		return NULL;
 
-	char*	spaced = replace(expr, "(", " ( ");
-			spaced = replace(spaced, ")", " ) ");
-			spaced = replace(spaced, "+", " + ");
-			spaced = replace(spaced, "-", " - ");
-			spaced = replace(spaced, "*", " * ");
-			spaced = replace(spaced, "/", " / ");
-			spaced = replace(spaced, "^", " ^ ");
-			spaced = replace(spaced, ",", " , ");
-
-	char* ctx = NULL;							// initialize context variable
-	char delim[] = " ";
-	char* token = strtok_s(spaced, delim, &ctx);	// initialize first token
-
-	while (token) {
-		push_back_to_doubly_linked_list(res, token);	// push to dll if not null
-		token = strtok_s(NULL, delim, &ctx);			// get next token value
+	if (!words_into(res, expr)) {
+		destroy_vector(res);
+		return NULL;
 	}
-
 	return res;
 }
 
@@ -71,272 +77,288 @@ bool strcmp_g_batch(char* str, char** strs) {
 }
 
 /*
-Returns the precedence of the operator passed to the function.
+Returns the precedence of the operator (by opcode) passed to the function.
 */
-unsigned prec(char* op) {
-	const char* add[] = { "+", "-", NULL };
-	const char* mul[] = { "*", "/",	NULL };
-	const char* exp[] = { "^",		NULL };
-	
-	if (strcmp_g_batch(op, add))
+unsigned prec(unsigned op) {
+	switch (op) {
+	case OP_ADD: case OP_SUB:
 		return 2;
-
-	else if (strcmp_g_batch(op, mul))
+	case OP_MUL: case OP_DIV:
 		return 3;
-
-	else if (strcmp_g_batch(op, exp))
+	case OP_POW:
 		return 4;
-
-	else
+	default:
 		return 0;
+	}
 }
 
-const char* operators[] = { "+", "-", "*", "/", "^", NULL };
-const char* functions[] = {
-	"sin",		"cos",		"tan",
-	"arcsin",	"arccos",	"arctan",
-	"log",		"ln",		"sqrt",
-	"exp",
-	"(",
-	NULL
-};
-
 /*
 Shunting yard algorithm for converting an expression in infix notation
 to an equivalent expression in postfix notation (i.e. reverse polish notation).
 The postfix expression can then be evaluated to a numerical value via a postfix
 stack evaluator algorithm.
-*/
-DoublyLinkedList* shunting_yard(DoublyLinkedList* infix) {
 
-	DoublyLinkedList* stack = new_doubly_linked_list(); // only push/pop
-	DoublyLinkedList* queue = new_doubly_linked_list(); // only push BACK/pop
-
-	while (infix->head) { // "while there are tokens to be read..."
-		char* token = pop_from_doubly_linked_list(infix);
-		//printf("token: %s\n", token);
+Reads the tokens of `infix` (as produced by `words_into`) and 
+appends the postfix expression to `postfix`, using `stack` as the 
+operator stack; both are cleared first. Each token is dispatched 
+on its kind. With vectors that have been used before, this makes 
+no heap allocations. Returns false if the parentheses don't match.
+*/
+bool shunting_yard_into(vector* infix, vector* stack, vector* postfix) {
 
-		//printf("infix: ");
-		//print_doubly_linked_list(infix);
+	clear_vector(stack);
+	clear_vector(postfix);
 
-		//printf("stack: ");
-		//print_doubly_linked_list(stack);
+	for (size_t i = 0; i < infix->len; i++) { // "while there are tokens to be read..."
+		token* tok = &vector_item(infix, token, i);
+		token* top;
+		bool ok = true;
 
-		//printf("queue: ");
-		//print_doubly_linked_list(queue);
+		switch (tok->kind) {
 
 		// "if the token is an operator..."
-		if ( strcmp_g_batch(token, operators) ) {
-			//puts("operator");
-			char* o1 = token;
-			char* o2 = stack->head;
-			bool prec_check = (
-				// "o2 has greater precedence than o1 or 
-				// (o1 and o2 have the same precedence and 
-				// o1 is left associative)"
-				prec(o2) > prec(o1) || ( prec(o1) == prec(o2) && o1 != "^" )
-			);
-				
-			while (o2 && !strcmp_g(o2, "(") && prec_check) {
-				push_back_to_doubly_linked_list(
-					queue,
-					pop_from_doubly_linked_list(stack)
+		case TOKEN_OPERATOR:
+			while ((top = (token*)vector_back(stack)) && top->kind == TOKEN_OPERATOR) {
+				unsigned o1 = tok->op, o2 = top->op;
+				bool prec_check = (
+					// "o2 has greater precedence than o1 or 
+					// (o1 and o2 have the same precedence and 
+					// o1 is left associative)"
+					prec(o2) > prec(o1) || ( prec(o1) == prec(o2) && o1 != OP_POW )
 				);
+				if (!prec_check)
+					break;
+
+				ok &= vector_push(postfix, vector_pop(stack)) != NULL;
 			}
-			push_to_doubly_linked_list(stack, token);
-		}
+			ok &= vector_push(stack, tok) != NULL;
+			break;
 
 		// "if the token is a function or left parenthesis..."
-		else if ( strcmp_g_batch(token, functions) ) {
-			//puts("function");
-			push_to_doubly_linked_list(stack, token);
-		}
+		case TOKEN_FUNCTION:
+		case TOKEN_LPAREN:
+			ok &= vector_push(stack, tok) != NULL;
+			break;
 
 		// "if the token is a comma..."
-		else if ( strcmp(token, ",") == 0 ) {
-			//puts("comma");
-			while (stack->head && stack->head->data != "(") {
-				push_back_to_doubly_linked_list(
-					queue,
-					pop_from_doubly_linked_list(stack)
-				);
-			}
-		}
+		case TOKEN_COMMA:
+			while ((top = (token*)vector_back(stack)) && top->kind != TOKEN_LPAREN)
+				ok &= vector_push(postfix, vector_pop(stack)) != NULL;
+			break;
 
 		// "if the token is a right parenthesis..."
-		else if ( strcmp(token, ")") == 0 ) {
-			//puts("r. parenthesis");
-			while (stack->head != NULL && strcmp(stack->head->data, "(") != 0) {
-				//printf("%s\n", stack->head->data);
-				push_back_to_doubly_linked_list(
-					queue,
-					pop_from_doubly_linked_list(stack)
-				);
-			}
-			// stack->head->data == "("
-			pop_from_doubly_linked_list(stack);									// discard left parenthesis
-			if (stack->head != NULL && strcmp_g_batch(stack->head->data, functions)) {	// move any following function call to the queue					
-				push_back_to_doubly_linked_list(
-					queue,
-					pop_from_doubly_linked_list(stack)
-				);
+		case TOKEN_RPAREN:
+			while ((top = (token*)vector_back(stack)) && top->kind != TOKEN_LPAREN)
+				ok &= vector_push(postfix, vector_pop(stack)) != NULL;
+
+			if (stack->len == 0) {
+				puts("error: unmatched right parenthesis... aborting shunting yard algorithm");
+				return false;
 			}
+			vector_pop(stack);												// discard left parenthesis
+			if ((top = (token*)vector_back(stack)) && top->kind == TOKEN_FUNCTION)	// move any following function call to the queue
+				ok &= vector_push(postfix, vector_pop(stack)) != NULL;
+			break;
+
+		// "if the token is a number (or variable)..."
+		default:
+			ok &= vector_push(postfix, tok) != NULL;
+			break;
 		}
 
-		// "if the token is a number..."
-		else {
-			//puts("number");
-			push_back_to_doubly_linked_list(queue, token);
-		}
+		if (!ok)
+			return false;
 	}
 
-	while (stack->head != NULL) {
-		if ( stack->head->data && // extra check to prevent warning from VS
-			strcmp(stack->head->data, "(") == 0 ) {
-			
+	while (stack->len) {
+		token* top = (token*)vector_pop(stack);
+		if (top->kind == TOKEN_LPAREN) {
 			puts("error: extra parenthesis found in operator stack... aborting shunting yard algorithm");
-			// free all malloced memory...
-			destroy_doubly_linked_list(stack);
-			destroy_doubly_linked_list(queue);
-			destroy_doubly_linked_list(infix);
-			return NULL;
+			return false;
 		}
-		push_back_to_doubly_linked_list(
-			queue,
-			pop_from_doubly_linked_list(stack)
-		);
+		if (!vector_push(postfix, top))
+			return false;
 	}
 
-	destroy_doubly_linked_list(infix);
-	destroy_doubly_linked_list(stack);
-
-	return queue;
+	return true;
 }
 
-long double postfix_evaluator(DoublyLinkedList* rpn) {
-	
-	DoublyLinkedList* stack = new_doubly_linked_list();
-	
-	while (rpn->head) {
-
-		//print_doubly_linked_list_ld(stack);
-
-		char* token = pop_from_doubly_linked_list(rpn);
-		//printf("token = %s\n\n", token);
-
-		// token is a function
-		if (strcmp_g_batch(token, functions)) {
-			long double value = pop_from_doubly_linked_list_ld(stack);
+/*
+Converts the infix tokens `infix` to a new vector of postfix 
+tokens with `shunting_yard_into`, consuming `infix`. Returns NULL 
+if the expression can't be converted.
+*/
+vector* shunting_yard(vector* infix) {
 
-			if (strcmp_g(token, "sin")) {
-				push_to_doubly_linked_list_ld(stack, sinl(value));
-			}
+	if (infix == NULL)
+		return NULL;
 
-			else if (strcmp_g(token, "cos")) {
-				push_to_doubly_linked_list_ld(stack, cosl(value));
-			}
+	vector* stack = new_vector(sizeof(token));
+	vector* postfix = new_vector(sizeof(token));
+	bool ok = stack && postfix
+		&& vector_reserve(stack, infix->len)
+		&& vector_reserve(postfix, infix->len)
+		&& shunting_yard_into(infix, stack, postfix);
+
+	destroy_vector(infix);
+	destroy_vector(stack);
+	if (!ok) {
+		destroy_vector(postfix);
+		return NULL;
+	}
+	return postfix;
+}
 
-			else if (strcmp_g(token, "tan")) {
-				push_to_doubly_linked_list_ld(stack, tanl(value));
-			}
+extern const char* __op_names[];
 
-			else if (strcmp_g(token, "arcsin")) {
-				push_to_doubly_linked_list_ld(stack, asinl(value));
-			}
+/*
+Evaluates a postfix expression with no variables in it, using 
+`values` as the value stack. Tokens are already classified, so 
+this is one switch per token, and with a `values` vector that has 
+been used before it makes no heap allocations. Code that evaluates 
+the same expression repeatedly should call `compile_postfix` once 
+and `run_program` on every evaluation instead.
+*/
+scalar evaluate_postfix(vector* rpn, vector* values) {
 
-			else if (strcmp_g(token, "arccos")) {
-				push_to_doubly_linked_list_ld(stack, acosl(value));
-			}
+	clear_vector(values);
+	if (!vector_reserve(values, rpn->len))
+		return (scalar)NAN;
+	scalar* sp = (scalar*)values->data; // next free slot
 
-			else if (strcmp_g(token, "arctan")) {
-				push_to_doubly_linked_list_ld(stack, atanl(value));
-			}
+	for (size_t i = 0; i < rpn->len; i++) {
+		token* tok = &vector_item(rpn, token, i);
+		switch (tok->kind) {
 
-			else if (strcmp_g(token, "log")) {
-				push_to_doubly_linked_list_ld(stack, log10l(value));
-			}
+		case TOKEN_NUMBER:
+			*sp++ = tok->value;
+			break;
 
-			else if (strcmp_g(token, "ln")) {
-				push_to_doubly_linked_list_ld(stack, logl(value));
+		case TOKEN_OPERATOR:
+			if (sp - (scalar*)values->data < 2) {
+				printf("error: operator '%s' is missing an operand. aborting postfix evaluation...\n", __op_names[tok->op - OP_ADD]);
+				return (scalar)NAN;
 			}
-
-			else if (strcmp_g(token, "sqrt")) {
-				push_to_doubly_linked_list_ld(stack, sqrtl(value));
+			sp--;
+			sp[-1] = apply_opcode(tok->op, sp[-1], sp[0]);
+			break;
+
+		case TOKEN_FUNCTION:
+			if (sp == (scalar*)values->data) {
+				printf("error: function '%s' is missing its argument. aborting postfix evaluation...\n", __op_names[tok->op - OP_ADD]);
+				return (scalar)NAN;
 			}
+			sp[-1] = apply_opcode(tok->op, sp[-1], 0);
+			break;
+
+		case TOKEN_IDENT:
+			printf("error: found unbound variable '%s'. aborting postfix evaluation...\n", interned_name(tok->name));
+			return (scalar)NAN;
+
+		default:
+			printf("error: found '");
+			print_token(tok);
+			puts("' in postfix expression. aborting postfix evaluation...");
+			return (scalar)NAN;
+		}
+	}
 
-			else if (strcmp_g(token, "exp")) {
-				push_to_doubly_linked_list_ld(stack, expl(value));
-			}
+	if (sp - (scalar*)values->data != 1) {
+		puts("error: postfix expression doesn't reduce to one value. aborting postfix evaluation...");
+		return (scalar)NAN;
+	}
+	return ((scalar*)values->data)[0];
+}
 
-			else if (strcmp_g(token, "(")) {
-				puts("error: found left parenthesis in postfix stack. aborting postfix evaluation...");
-				return (long double)NAN;
-			}
+/*
+Evaluates a postfix expression with no variables in it, consuming 
+the vector.
+*/
+scalar postfix_evaluator(vector* rpn) {
 
-			else {
-				printf("error: found unknown function '%s'. aborting postfix evaluation...\n", token);
-				destroy_doubly_linked_list(stack);
-				return (long double)NAN;
-			}
+	if (rpn == NULL)
+		return (scalar)NAN;
 
-		}
+	vector* values = new_vector(sizeof(scalar));
+	scalar res = values ? evaluate_postfix(rpn, values) : (scalar)NAN;
+	destroy_vector(values);
+	destroy_vector(rpn);
+	return res;
+}
 
-		// token is an operator/binary function
-		else if (strcmp_g_batch(token, operators)) {
-			long double second_val = pop_from_doubly_linked_list_ld(stack);
-			long double first_val = pop_from_doubly_linked_list_ld(stack);
-
-			switch (*token) {
-			case '+':
-				push_to_doubly_linked_list_ld(stack, first_val + second_val);
-				break;
-			case '-':
-				push_to_doubly_linked_list_ld(stack, first_val - second_val);
-				break;
-			case '*':
-				push_to_doubly_linked_list_ld(stack, first_val * second_val);
-				break;
-			case '/':
-				push_to_doubly_linked_list_ld(stack, first_val / second_val);
-				break;
-			case '^':
-				push_to_doubly_linked_list_ld(stack, powl(first_val, second_val));
-				break;
-			default:
-				printf("error: found unknown binary operator: '%c'. aborting postfix evaluation...\n", *token);
-				destroy_doubly_linked_list(stack);
-				return (long double)NAN;
-				break;
-			}
-		}
+/*
+The buffers one expression is parsed and evaluated in. Reusing a 
+parser for every expression means that, once its vectors have 
+grown to fit the largest expression, parsing and evaluating make 
+no heap allocations at all.
+*/
+typedef struct {
+	vector* infix;
+	vector* stack;
+	vector* postfix;
+	vector* values;
+} parser;
+
+void destroy_parser(parser* p) {
+	if (p == NULL)
+		return;
+	destroy_vector(p->infix);
+	destroy_vector(p->stack);
+	destroy_vector(p->postfix);
+	destroy_vector(p->values);
+	free(p);
+	p = NULL;
+}
 
-		// token is a number (probably)
-		else {
-			long double value = strtold(token, NULL);
-			push_to_doubly_linked_list_ld(stack, value);
-		}
+/*
+Constructs a new parser with empty buffers, returning NULL if it fails.
+*/
+parser* new_parser(void) {
+	parser* p = (parser*)malloc(sizeof(parser));
+	if (p == NULL) {
+		puts("error: insufficient heap memory for new parser");
+		return NULL;
 	}
-
-	long double res = pop_from_doubly_linked_list_ld(stack);
-
-	if (stack->head != NULL) {
-		puts("error: leftover items in postfix stack. aborting postfix evaluation...");
-		destroy_doubly_linked_list(stack);
-		return (long double)NAN;
+	p->infix = new_vector(sizeof(token));
+	p->stack = new_vector(sizeof(token));
+	p->postfix = new_vector(sizeof(token));
+	p->values = new_vector(sizeof(scalar));
+	if (!p->infix || !p->stack || !p->postfix || !p->values) {
+		destroy_parser(p);
+		return NULL;
 	}
+	return p;
+}
 
-	destroy_doubly_linked_list(stack);
-	//printf("returning: %Lf\n\n", res);
-	return res;
+/*
+Parses `expr` into the parser's `postfix` vector, returning false 
+if it can't be parsed.
+*/
+bool parse_into(parser* p, char* expr) {
+	clear_vector(p->infix);
+	return words_into(p->infix, expr)
+		&& shunting_yard_into(p->infix, p->stack, p->postfix);
+}
+
+/*
+Evaluates an expression with no variables in it, in the buffers 
+of the parser `p`.
+*/
+scalar eval_str_in(parser* p, char* expr) {
+	if (!parse_into(p, expr))
+		return (scalar)NAN;
+	return evaluate_postfix(p->postfix, p->values);
 }
 
-long double eval_str(char* expr) {
+/*
+Evaluates an expression with no variables in it.
+*/
+scalar eval_str(char* expr) {
+	parser* p = new_parser();
+	if (p == NULL)
+		return (scalar)NAN;
 
-	return postfix_evaluator(
-		shunting_yard(
-			words(
-				expr
-			)
-		)
-	);
-}
\ No newline at end of file
+	scalar res = eval_str_in(p, expr);
+	destroy_parser(p);
+	return res;
+}
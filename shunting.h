@@ -1,18 +1,39 @@
 #pragma once
 #include <stdbool.h>
+#include "precision.h"
 #include "dlinklist.h"
 
 bool strcmp_g(char* s1, char* s2);
 
 bool strcmp_g_batch(char* str, char** strs);
 
-const char* operators[];
-const char* functions[];
+unsigned prec(unsigned op);
 
-DoublyLinkedList* words(char* expr);
+bool words_into(vector* tokens, char* expr);
 
-DoublyLinkedList* shunting_yard(DoublyLinkedList* infix);
+vector* words(char* expr);
 
-long double postfix_evaluator(DoublyLinkedList* rpn);
+bool shunting_yard_into(vector* infix, vector* stack, vector* postfix);
 
-long double eval_str(char* expr);
\ No newline at end of file
+vector* shunting_yard(vector* infix);
+
+scalar evaluate_postfix(vector* rpn, vector* values);
+
+scalar postfix_evaluator(vector* rpn);
+
+typedef struct {
+	vector* infix;
+	vector* stack;
+	vector* postfix;
+	vector* values;
+} parser;
+
+void destroy_parser(parser* p);
+
+parser* new_parser(void);
+
+bool parse_into(parser* p, char* expr);
+
+scalar eval_str_in(parser* p, char* expr);
+
+scalar eval_str(char* expr);
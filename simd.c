@@ -0,0 +1,630 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include <threads.h>
+#include "clinalg.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SIMD_TARGET(t)
+#else
+#include <cpuid.h>
+#define SIMD_TARGET(t) __attribute__((target(t)))
+#endif
+#endif
+
+/*
+Instruction set extensions the vector kernels can be run with, 
+from least to most capable.
+*/
+typedef enum {
+	SIMD_SCALAR,
+	SIMD_AVX2,
+	SIMD_AVX512
+} simd_level;
+
+/*
+Element-wise operations of the expression kernels (see 
+`vec_binary_<t>` and `vec_unary_<t>`). The binary ones are in the 
+same order as OP_ADD..OP_DIV.
+*/
+typedef enum {
+	VEC_ADD,
+	VEC_SUB,
+	VEC_MUL,
+	VEC_DIV
+} vec_binop;
+
+typedef enum {
+	VEC_SQRT,
+	VEC_EXP,
+	VEC_LN,
+	VEC_SIN,
+	VEC_COS
+} vec_fn;
+
+/*
+Largest relative error of the polynomial approximations 
+`vec_unary_d` uses for exp, ln, sin and cos when asked to (near 
+the zeros of sin and cos, it bounds the absolute error instead). 
+Everything else the kernels compute is exact to the last bit.
+*/
+#define VEC_APPROX_ERROR 1e-14
+
+#ifdef SIMD_X86
+
+void __cpuid_g(unsigned leaf, unsigned sub, unsigned regs[4]) {
+#if defined(_MSC_VER)
+	__cpuidex((int*)regs, (int)leaf, (int)sub);
+#else
+	__cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+/*
+Reads the register state the OS saves on context switch (XCR0). 
+A CPU may support AVX while the OS doesn't preserve its registers.
+*/
+unsigned long long __xgetbv0(void) {
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned lo, hi;
+	__asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+
+#endif
+
+/*
+Returns the most capable vector extension that both the CPU 
+(per CPUID) and the OS (per XCR0) support.
+*/
+simd_level simd_detect(void) {
+#ifdef SIMD_X86
+	unsigned r[4];
+	__cpuid_g(0, 0, r);
+	if (r[0] < 7)
+		return SIMD_SCALAR;
+
+	__cpuid_g(1, 0, r);
+	bool osxsave = r[2] & (1u << 27);
+	bool avx = r[2] & (1u << 28);
+	bool fma = r[2] & (1u << 12);
+	if (!osxsave || !avx || !fma)
+		return SIMD_SCALAR;
+
+	unsigned long long xcr0 = __xgetbv0();
+	if ((xcr0 & 0x6) != 0x6) // XMM and YMM state
+		return SIMD_SCALAR;
+
+	__cpuid_g(7, 0, r);
+	bool avx2 = r[1] & (1u << 5);
+	bool avx512f = r[1] & (1u << 16);
+
+	if (avx512f && (xcr0 & 0xE0) == 0xE0) // opmask and ZMM state
+		return SIMD_AVX512;
+	if (avx2)
+		return SIMD_AVX2;
+#endif
+	return SIMD_SCALAR;
+}
+
+
+/*
+Portable fallbacks of the expression kernels, generated once per 
+supported scalar type with the suffix of its libm functions.
+*/
+#define DEFINE_MAP_KERNELS(suffix, type, lm)										\
+void __binary_##suffix##_scalar(vec_binop op, type* out, const type* x, const type* y, size_t n) {	\
+	switch (op) {																\
+	case VEC_ADD:	for (size_t i = 0; i < n; i++) out[i] = x[i] + y[i];	break;	\
+	case VEC_SUB:	for (size_t i = 0; i < n; i++) out[i] = x[i] - y[i];	break;	\
+	case VEC_MUL:	for (size_t i = 0; i < n; i++) out[i] = x[i] * y[i];	break;	\
+	case VEC_DIV:	for (size_t i = 0; i < n; i++) out[i] = x[i] / y[i];	break;	\
+	}																			\
+}																				\
+void __unary_##suffix##_scalar(vec_fn fn, type* out, const type* x, size_t n) {	\
+	switch (fn) {																\
+	case VEC_SQRT:	for (size_t i = 0; i < n; i++) out[i] = sqrt##lm(x[i]);	break;	\
+	case VEC_EXP:	for (size_t i = 0; i < n; i++) out[i] = exp##lm(x[i]);	break;	\
+	case VEC_LN:	for (size_t i = 0; i < n; i++) out[i] = log##lm(x[i]);	break;	\
+	case VEC_SIN:	for (size_t i = 0; i < n; i++) out[i] = sin##lm(x[i]);	break;	\
+	case VEC_COS:	for (size_t i = 0; i < n; i++) out[i] = cos##lm(x[i]);	break;	\
+	}																			\
+}
+
+DEFINE_MAP_KERNELS(f, float, f)
+DEFINE_MAP_KERNELS(d, double, )
+DEFINE_MAP_KERNELS(ld, long double, l)
+
+#ifdef SIMD_X86
+
+SIMD_TARGET("avx2,fma")
+void __axpy_d_avx2(double* a, const double* b, double coef, size_t n) {
+	__m256d c = _mm256_set1_pd(coef);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256d a0 = _mm256_loadu_pd(a + i), a1 = _mm256_loadu_pd(a + i + 4);
+		a0 = _mm256_fmadd_pd(_mm256_loadu_pd(b + i), c, a0);
+		a1 = _mm256_fmadd_pd(_mm256_loadu_pd(b + i + 4), c, a1);
+		_mm256_storeu_pd(a + i, a0);
+		_mm256_storeu_pd(a + i + 4, a1);
+	}
+	for (; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(a + i, _mm256_fmadd_pd(_mm256_loadu_pd(b + i), c, _mm256_loadu_pd(a + i)));
+	for (; i < n; i++)
+		a[i] += b[i] * coef;
+}
+
+SIMD_TARGET("avx2,fma")
+void __scale_d_avx2(double* a, double coef, size_t n) {
+	__m256d c = _mm256_set1_pd(coef);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(a + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), c));
+	for (; i < n; i++)
+		a[i] *= coef;
+}
+
+SIMD_TARGET("avx2,fma")
+void __axpy_f_avx2(float* a, const float* b, float coef, size_t n) {
+	__m256 c = _mm256_set1_ps(coef);
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m256 a0 = _mm256_loadu_ps(a + i), a1 = _mm256_loadu_ps(a + i + 8);
+		a0 = _mm256_fmadd_ps(_mm256_loadu_ps(b + i), c, a0);
+		a1 = _mm256_fmadd_ps(_mm256_loadu_ps(b + i + 8), c, a1);
+		_mm256_storeu_ps(a + i, a0);
+		_mm256_storeu_ps(a + i + 8, a1);
+	}
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(a + i, _mm256_fmadd_ps(_mm256_loadu_ps(b + i), c, _mm256_loadu_ps(a + i)));
+	for (; i < n; i++)
+		a[i] += b[i] * coef;
+}
+
+SIMD_TARGET("avx2,fma")
+void __scale_f_avx2(float* a, float coef, size_t n) {
+	__m256 c = _mm256_set1_ps(coef);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(a + i, _mm256_mul_ps(_mm256_loadu_ps(a + i), c));
+	for (; i < n; i++)
+		a[i] *= coef;
+}
+
+/*
+The AVX-512 kernels finish each row with one masked operation 
+instead of a scalar tail loop.
+*/
+SIMD_TARGET("avx512f")
+void __axpy_d_avx512(double* a, const double* b, double coef, size_t n) {
+	__m512d c = _mm512_set1_pd(coef);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm512_storeu_pd(a + i, _mm512_fmadd_pd(_mm512_loadu_pd(b + i), c, _mm512_loadu_pd(a + i)));
+	if (i < n) {
+		__mmask8 m = (__mmask8)((1u << (n - i)) - 1);
+		__m512d av = _mm512_maskz_loadu_pd(m, a + i);
+		__m512d bv = _mm512_maskz_loadu_pd(m, b + i);
+		_mm512_mask_storeu_pd(a + i, m, _mm512_fmadd_pd(bv, c, av));
+	}
+}
+
+SIMD_TARGET("avx512f")
+void __scale_d_avx512(double* a, double coef, size_t n) {
+	__m512d c = _mm512_set1_pd(coef);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm512_storeu_pd(a + i, _mm512_mul_pd(_mm512_loadu_pd(a + i), c));
+	if (i < n) {
+		__mmask8 m = (__mmask8)((1u << (n - i)) - 1);
+		_mm512_mask_storeu_pd(a + i, m, _mm512_mul_pd(_mm512_maskz_loadu_pd(m, a + i), c));
+	}
+}
+
+SIMD_TARGET("avx512f")
+void __axpy_f_avx512(float* a, const float* b, float coef, size_t n) {
+	__m512 c = _mm512_set1_ps(coef);
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+		_mm512_storeu_ps(a + i, _mm512_fmadd_ps(_mm512_loadu_ps(b + i), c, _mm512_loadu_ps(a + i)));
+	if (i < n) {
+		__mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+		__m512 av = _mm512_maskz_loadu_ps(m, a + i);
+		__m512 bv = _mm512_maskz_loadu_ps(m, b + i);
+		_mm512_mask_storeu_ps(a + i, m, _mm512_fmadd_ps(bv, c, av));
+	}
+}
+
+SIMD_TARGET("avx512f")
+void __scale_f_avx512(float* a, float coef, size_t n) {
+	__m512 c = _mm512_set1_ps(coef);
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+		_mm512_storeu_ps(a + i, _mm512_mul_ps(_mm512_loadu_ps(a + i), c));
+	if (i < n) {
+		__mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+		_mm512_mask_storeu_ps(a + i, m, _mm512_mul_ps(_mm512_maskz_loadu_ps(m, a + i), c));
+	}
+}
+
+SIMD_TARGET("avx2,fma")
+void __binary_d_avx2(vec_binop op, double* out, const double* x, const double* y, size_t n) {
+	size_t i = 0;
+	switch (op) {
+	case VEC_ADD:
+		for (; i + 4 <= n; i += 4)
+			_mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+		break;
+	case VEC_SUB:
+		for (; i + 4 <= n; i += 4)
+			_mm256_storeu_pd(out + i, _mm256_sub_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+		break;
+	case VEC_MUL:
+		for (; i + 4 <= n; i += 4)
+			_mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+		break;
+	case VEC_DIV:
+		for (; i + 4 <= n; i += 4)
+			_mm256_storeu_pd(out + i, _mm256_div_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+		break;
+	}
+	_mm256_zeroupper();
+	__binary_d_scalar(op, out + i, x + i, y + i, n - i);
+}
+
+SIMD_TARGET("avx2,fma")
+void __binary_f_avx2(vec_binop op, float* out, const float* x, const float* y, size_t n) {
+	size_t i = 0;
+	switch (op) {
+	case VEC_ADD:
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+		break;
+	case VEC_SUB:
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(out + i, _mm256_sub_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+		break;
+	case VEC_MUL:
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+		break;
+	case VEC_DIV:
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+		break;
+	}
+	_mm256_zeroupper();
+	__binary_f_scalar(op, out + i, x + i, y + i, n - i);
+}
+
+/*
+Rounds each lane (already integral valued) to an int64 by adding 
+1.5 * 2^52, which leaves the integer in the low mantissa bits. 
+Exact for |k| < 2^51; AVX2 has no double to int64 conversion.
+*/
+SIMD_TARGET("avx2,fma")
+__m256i __pd_to_epi64(__m256d k) {
+	__m256d magic = _mm256_set1_pd(6755399441055744.0);
+	return _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(k, magic)), _mm256_castpd_si256(magic));
+}
+
+/*
+exp(x) = 2^k * exp(r) with r = x - k ln2, |r| <= ln2 / 2, where 
+exp(r) is its Taylor polynomial to degree 13. Valid for x in 
+[-708, 709], so that 2^k is a normal double.
+*/
+SIMD_TARGET("avx2,fma")
+__m256d __exp_pd(__m256d x) {
+	__m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.44269504088896340736)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(6.93147180369123816490e-01), x);
+	r = _mm256_fnmadd_pd(k, _mm256_set1_pd(1.90821492927058770002e-10), r);
+
+	__m256d p = _mm256_set1_pd(1.0 / 6227020800.0);
+	static const double c[] = { 
+		1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0, 1.0 / 40320.0, 
+		1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 0.5, 1.0, 1.0 
+	};
+	for (int i = 0; i < 13; i++)
+		p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(c[i]));
+
+	__m256i e = _mm256_add_epi64(__pd_to_epi64(k), _mm256_set1_epi64x(1023));
+	return _mm256_mul_pd(p, _mm256_castsi256_pd(_mm256_slli_epi64(e, 52)));
+}
+
+/*
+ln(x) = e ln2 + ln(m) for x = m 2^e with m in [sqrt(1/2), sqrt(2)), 
+where ln(m) = 2 atanh(f), f = (m - 1) / (m + 1), summed to f^23. 
+Valid for positive, normal, finite x.
+*/
+SIMD_TARGET("avx2,fma")
+__m256d __ln_pd(__m256d x) {
+	__m256i bits = _mm256_castpd_si256(x);
+	__m256d two52 = _mm256_set1_pd(4503599627370496.0);
+	__m256i ebits = _mm256_srli_epi64(bits, 52);
+	__m256d e = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(ebits, _mm256_castpd_si256(two52))), two52);
+	e = _mm256_sub_pd(e, _mm256_set1_pd(1023.0));
+
+	__m256i mant = _mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL));
+	__m256d m = _mm256_castsi256_pd(_mm256_or_si256(mant, _mm256_castpd_si256(_mm256_set1_pd(1.0))));
+	__m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(1.41421356237309504880), _CMP_GT_OQ);
+	m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+	e = _mm256_add_pd(e, _mm256_and_pd(big, _mm256_set1_pd(1.0)));
+
+	__m256d f = _mm256_div_pd(_mm256_sub_pd(m, _mm256_set1_pd(1.0)), _mm256_add_pd(m, _mm256_set1_pd(1.0)));
+	__m256d s = _mm256_mul_pd(f, f);
+	__m256d p = _mm256_set1_pd(1.0 / 23.0);
+	for (int i = 21; i >= 3; i -= 2)
+		p = _mm256_fmadd_pd(p, s, _mm256_set1_pd(1.0 / i));
+	p = _mm256_mul_pd(_mm256_mul_pd(p, s), f);	// atanh(f) - f
+
+	__m256d lo = _mm256_fmadd_pd(e, _mm256_set1_pd(1.90821492927058770002e-10), _mm256_add_pd(p, p));
+	return _mm256_add_pd(_mm256_fmadd_pd(e, _mm256_set1_pd(6.93147180369123816490e-01), _mm256_add_pd(f, f)), lo);
+}
+
+/*
+sin(x) (or cos(x), which is sin shifted by one quadrant) from 
+r = x - k pi/2, |r| <= pi/4, reduced in three parts, and the Taylor 
+polynomials of sin(r) and cos(r) picked and signed by k mod 4. 
+Valid for |x| <= 1e5.
+*/
+SIMD_TARGET("avx2,fma")
+__m256d __sincos_pd(__m256d x, int quadrant) {
+	__m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(6.36619772367581382433e-01)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(1.57079632673412561417e+00), x);
+	r = _mm256_fnmadd_pd(k, _mm256_set1_pd(6.07710050630396597660e-11), r);
+	r = _mm256_fnmadd_pd(k, _mm256_set1_pd(2.02226624871116645580e-21), r);
+	__m256d r2 = _mm256_mul_pd(r, r);
+
+	__m256d sp = _mm256_set1_pd(1.0 / 355687428096000.0);
+	__m256d cp = _mm256_set1_pd(1.0 / 20922789888000.0);
+	static const double sc[] = { 
+		-1.0 / 1307674368000.0, 1.0 / 6227020800.0, -1.0 / 39916800.0, 
+		1.0 / 362880.0, -1.0 / 5040.0, 1.0 / 120.0, -1.0 / 6.0, 1.0 
+	};
+	static const double cc[] = { 
+		-1.0 / 87178291200.0, 1.0 / 479001600.0, -1.0 / 3628800.0, 
+		1.0 / 40320.0, -1.0 / 720.0, 1.0 / 24.0, -0.5, 1.0 
+	};
+	for (int i = 0; i < 8; i++) {
+		sp = _mm256_fmadd_pd(sp, r2, _mm256_set1_pd(sc[i]));
+		cp = _mm256_fmadd_pd(cp, r2, _mm256_set1_pd(cc[i]));
+	}
+	sp = _mm256_mul_pd(sp, r);
+
+	__m256i q = _mm256_add_epi64(__pd_to_epi64(k), _mm256_set1_epi64x(quadrant));
+	__m256d res = _mm256_blendv_pd(sp, cp, _mm256_castsi256_pd(_mm256_slli_epi64(q, 63)));
+	__m256i sign = _mm256_slli_epi64(_mm256_srli_epi64(q, 1), 63);
+	return _mm256_xor_pd(res, _mm256_castsi256_pd(sign));
+}
+
+/*
+The fallbacks are SSE code, so the upper halves of the YMM 
+registers are cleared before calling them; legacy SSE code run 
+with them dirty is many times slower on some CPUs, and the 
+compiler doesn't always do it on a tail call. Vector sqrt is 
+correctly rounded, so it is always used. The 
+approximations of the other functions are used only when `approx` 
+is set; groups of four with a lane outside an approximation's 
+range fall back to libm, so every input gets the same answer libm 
+would give to within `VEC_APPROX_ERROR`, including infinities and 
+NaNs.
+*/
+SIMD_TARGET("avx2,fma")
+void __unary_d_avx2(vec_fn fn, double* out, const double* x, size_t n, bool approx) {
+	size_t i = 0;
+	if (fn == VEC_SQRT) {
+		for (; i + 4 <= n; i += 4)
+			_mm256_storeu_pd(out + i, _mm256_sqrt_pd(_mm256_loadu_pd(x + i)));
+	}
+	else if (approx) {
+		for (; i + 4 <= n; i += 4) {
+			__m256d v = _mm256_loadu_pd(x + i), ok, res;
+			switch (fn) {
+			case VEC_EXP:
+				ok = _mm256_and_pd(_mm256_cmp_pd(v, _mm256_set1_pd(-708.0), _CMP_GE_OQ), _mm256_cmp_pd(v, _mm256_set1_pd(709.0), _CMP_LE_OQ));
+				res = __exp_pd(v);
+				break;
+			case VEC_LN:
+				ok = _mm256_and_pd(_mm256_cmp_pd(v, _mm256_set1_pd(DBL_MIN), _CMP_GE_OQ), _mm256_cmp_pd(v, _mm256_set1_pd(DBL_MAX), _CMP_LE_OQ));
+				res = __ln_pd(v);
+				break;
+			default:
+				ok = _mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), v), _mm256_set1_pd(1e5), _CMP_LE_OQ);
+				res = __sincos_pd(v, fn == VEC_COS);
+				break;
+			}
+			if (_mm256_movemask_pd(ok) == 0xF)
+				_mm256_storeu_pd(out + i, res);
+			else {
+				_mm256_zeroupper();
+				__unary_d_scalar(fn, out + i, x + i, 4);
+			}
+		}
+	}
+	_mm256_zeroupper();
+	__unary_d_scalar(fn, out + i, x + i, n - i);
+}
+
+SIMD_TARGET("avx2,fma")
+void __unary_f_avx2(vec_fn fn, float* out, const float* x, size_t n, bool approx) {
+	(void)approx;	// only double has approximations
+	size_t i = 0;
+	if (fn == VEC_SQRT) {
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(out + i, _mm256_sqrt_ps(_mm256_loadu_ps(x + i)));
+	}
+	_mm256_zeroupper();
+	__unary_f_scalar(fn, out + i, x + i, n - i);
+}
+
+#endif
+
+void (*__axpy_d)(double*, const double*, double, size_t) = NULL;
+void (*__scale_d)(double*, double, size_t) = NULL;
+void (*__axpy_f)(float*, const float*, float, size_t) = NULL;
+void (*__scale_f)(float*, float, size_t) = NULL;
+void (*__binary_d)(vec_binop, double*, const double*, const double*, size_t) = NULL;
+void (*__binary_f)(vec_binop, float*, const float*, const float*, size_t) = NULL;
+void (*__unary_d)(vec_fn, double*, const double*, size_t, bool) = NULL;
+void (*__unary_f)(vec_fn, float*, const float*, size_t, bool) = NULL;
+
+void __unary_d_portable(vec_fn fn, double* out, const double* x, size_t n, bool approx) {
+	(void)approx;
+	__unary_d_scalar(fn, out, x, n);
+}
+
+void __unary_f_portable(vec_fn fn, float* out, const float* x, size_t n, bool approx) {
+	(void)approx;
+	__unary_f_scalar(fn, out, x, n);
+}
+
+/*
+Points the vector kernels at the implementations for `level`, 
+capped at what `simd_detect` reports so that forcing a level the 
+machine lacks can't fault. Returns the level actually selected.
+*/
+simd_level __simd_apply(simd_level level) {
+	simd_level best = simd_detect();
+	if (level > best)
+		level = best;
+
+	__axpy_d = row_axpy_d;
+	__scale_d = row_scale_d;
+	__axpy_f = row_axpy_f;
+	__scale_f = row_scale_f;
+	__binary_d = __binary_d_scalar;
+	__binary_f = __binary_f_scalar;
+	__unary_d = __unary_d_portable;
+	__unary_f = __unary_f_portable;
+
+#ifdef SIMD_X86
+	// the expression kernels have no AVX-512 variants; AVX2 serves both
+	if (level >= SIMD_AVX2) {
+		__binary_d = __binary_d_avx2;
+		__binary_f = __binary_f_avx2;
+		__unary_d = __unary_d_avx2;
+		__unary_f = __unary_f_avx2;
+	}
+	if (level == SIMD_AVX512) {
+		__axpy_d = __axpy_d_avx512;
+		__scale_d = __scale_d_avx512;
+		__axpy_f = __axpy_f_avx512;
+		__scale_f = __scale_f_avx512;
+	}
+	else if (level == SIMD_AVX2) {
+		__axpy_d = __axpy_d_avx2;
+		__scale_d = __scale_d_avx2;
+		__axpy_f = __axpy_f_avx2;
+		__scale_f = __scale_f_avx2;
+	}
+#endif
+	return level;
+}
+
+/*
+The kernels pick `simd_detect()` exactly once, the first time any 
+of them runs, through `call_once`, so threadpool workers reaching 
+them first can't race on the function pointers.
+*/
+once_flag __simd_once = ONCE_FLAG_INIT;
+
+void __simd_default(void) {
+	__simd_apply(SIMD_AVX512);
+}
+
+/*
+Overrides the vector extension the kernels run with (see 
+`__simd_apply`) and returns the level actually selected. Unlike 
+the kernels' own one-time selection, this isn't synchronized with 
+them: call it before handing work to other threads.
+*/
+simd_level simd_select(simd_level level) {
+	call_once(&__simd_once, __simd_default);
+	return __simd_apply(level);
+}
+
+/*
+Adds `b * coef` to `a` over `n` values using the widest vector 
+unit available, falling back to the scalar `row_axpy_d`.
+*/
+void vec_axpy_d(double* a, const double* b, double coef, size_t n) {
+	call_once(&__simd_once, __simd_default);
+	__axpy_d(a, b, coef, n);
+}
+
+/*
+Multiplies `a` by `coef` over `n` values, vectorized like `vec_axpy_d`.
+*/
+void vec_scale_d(double* a, double coef, size_t n) {
+	call_once(&__simd_once, __simd_default);
+	__scale_d(a, coef, n);
+}
+
+void vec_axpy_f(float* a, const float* b, float coef, size_t n) {
+	call_once(&__simd_once, __simd_default);
+	__axpy_f(a, b, coef, n);
+}
+
+void vec_scale_f(float* a, float coef, size_t n) {
+	call_once(&__simd_once, __simd_default);
+	__scale_f(a, coef, n);
+}
+
+/*
+There are no vector units for long double, so the high precision 
+mode always runs the scalar kernels.
+*/
+void vec_axpy_ld(long double* a, const long double* b, long double coef, size_t n) {
+	row_axpy_ld(a, b, coef, n);
+}
+
+void vec_scale_ld(long double* a, long double coef, size_t n) {
+	row_scale_ld(a, coef, n);
+}
+
+/*
+Writes `x[i] op y[i]` to `out[i]` over `n` values; `out` may be 
+`x` or `y`. Vectorized with AVX2 where available.
+*/
+void vec_binary_d(vec_binop op, double* out, const double* x, const double* y, size_t n) {
+	call_once(&__simd_once, __simd_default);
+	__binary_d(op, out, x, y, n);
+}
+
+void vec_binary_f(vec_binop op, float* out, const float* x, const float* y, size_t n) {
+	call_once(&__simd_once, __simd_default);
+	__binary_f(op, out, x, y, n);
+}
+
+void vec_binary_ld(vec_binop op, long double* out, const long double* x, const long double* y, size_t n) {
+	__binary_ld_scalar(op, out, x, y, n);
+}
+
+/*
+Writes `fn(x[i])` to `out[i]` over `n` values; `out` may be `x`. 
+With `approx` set, exp, ln, sin and cos may be computed with 
+polynomial approximations good to `VEC_APPROX_ERROR` (double 
+only, with AVX2); otherwise every value matches libm exactly.
+*/
+void vec_unary_d(vec_fn fn, double* out, const double* x, size_t n, bool approx) {
+	call_once(&__simd_once, __simd_default);
+	__unary_d(fn, out, x, n, approx);
+}
+
+void vec_unary_f(vec_fn fn, float* out, const float* x, size_t n, bool approx) {
+	call_once(&__simd_once, __simd_default);
+	__unary_f(fn, out, x, n, approx);
+}
+
+void vec_unary_ld(vec_fn fn, long double* out, const long double* x, size_t n, bool approx) {
+	(void)approx;
+	__unary_ld_scalar(fn, out, x, n);
+}
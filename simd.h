@@ -0,0 +1,54 @@
+#pragma once
+#include <stdlib.h>
+#include <stdbool.h>
+
+typedef enum {
+	SIMD_SCALAR,
+	SIMD_AVX2,
+	SIMD_AVX512
+} simd_level;
+
+typedef enum {
+	VEC_ADD,
+	VEC_SUB,
+	VEC_MUL,
+	VEC_DIV
+} vec_binop;
+
+typedef enum {
+	VEC_SQRT,
+	VEC_EXP,
+	VEC_LN,
+	VEC_SIN,
+	VEC_COS
+} vec_fn;
+
+#define VEC_APPROX_ERROR 1e-14
+
+simd_level simd_detect(void);
+
+simd_level simd_select(simd_level level);
+
+void vec_axpy_d(double* a, const double* b, double coef, size_t n);
+
+void vec_scale_d(double* a, double coef, size_t n);
+
+void vec_axpy_f(float* a, const float* b, float coef, size_t n);
+
+void vec_scale_f(float* a, float coef, size_t n);
+
+void vec_axpy_ld(long double* a, const long double* b, long double coef, size_t n);
+
+void vec_scale_ld(long double* a, long double coef, size_t n);
+
+void vec_binary_d(vec_binop op, double* out, const double* x, const double* y, size_t n);
+
+void vec_binary_f(vec_binop op, float* out, const float* x, const float* y, size_t n);
+
+void vec_binary_ld(vec_binop op, long double* out, const long double* x, const long double* y, size_t n);
+
+void vec_unary_d(vec_fn fn, double* out, const double* x, size_t n, bool approx);
+
+void vec_unary_f(vec_fn fn, float* out, const float* x, size_t n, bool approx);
+
+void vec_unary_ld(vec_fn fn, long double* out, const long double* x, size_t n, bool approx);
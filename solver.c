@@ -0,0 +1,957 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+#include "precision.h"
+#include "clinalg.h"
+#include "simd.h"
+#include "dlinklist.h"
+#include "shunting.h"
+#include "bytecode.h"
+#include "stupidmath.h"
+#include "jit.h"
+#include "symbolic.h"
+
+/*
+A system of equations parsed and compiled once, ready to be 
+evaluated any number of times. `unknowns` holds every variable 
+that appears in any equation, in order of first appearance, and 
+is the solver's iterate. Equation `i` is `eqns[i] = 0`, compiled 
+from the postfix form `postfix[i]` that `unknowns` takes its names 
+from.
+
+Each equation is compiled against only its own variables, so its 
+program stays the size of the equation however many unknowns the 
+system has. `pattern` records which ones: slot `k` of `eqns[i]` is 
+the unknown in column `colidx[rowptr[i] + k]`, so the rows of 
+`pattern` are also the sparsity pattern of the Jacobian (its 
+values are unused). `env` and `grad` are scratch space for one 
+equation's variables and partials, and `widest` is their size.
+
+`sym` is the symbolic Jacobian of the equations, built the first 
+time `use_symbolic_jacobian` turns `symbolic` on and kept until the 
+system is destroyed. While `symbolic` is set, residuals and exact 
+Jacobians are evaluated from it instead of from `eqns`.
+*/
+typedef struct {
+	size_t len;
+	varmap* unknowns;
+	vector** postfix;
+	csr_matrix* pattern;
+	scalar* env;
+	scalar* grad;
+	size_t widest;
+	symbolic_jacobian* sym;
+	bool symbolic;
+	program* eqns[];
+} nonlinear_system;
+
+void destroy_nonlinear_system(nonlinear_system* s) {
+	for (size_t i = 0; i < s->len; i++) {
+		if (s->eqns[i])
+			destroy_program(s->eqns[i]);
+		if (s->postfix && s->postfix[i])
+			destroy_vector(s->postfix[i]);
+	}
+	free(s->postfix);
+	free(s->unknowns);
+	if (s->pattern)
+		destroy_csr(s->pattern);
+	if (s->sym)
+		destroy_symbolic_jacobian(s->sym);
+	free(s->env);
+	free(s);
+	s = NULL;
+}
+
+/*
+Parses every equation string of `sys` (`lhs = rhs`) once, gathers 
+the unknowns and compiles each equation. Returns NULL if an 
+equation can't be parsed or compiled, or if the system doesn't 
+have exactly as many unknowns as equations. The equation strings 
+are left untouched.
+*/
+nonlinear_system* new_nonlinear_system(DoublyLinkedList* sys) {
+	size_t n = 0;
+	for (snode* tmp = sys->head; tmp; tmp = tmp->next)
+		n++;
+
+	nonlinear_system* s = (nonlinear_system*)calloc(1, sizeof(nonlinear_system) + sizeof(program*) * n);
+	if (s == NULL) {
+		puts("error: insufficient heap memory for new system of equations");
+		return NULL;
+	}
+	s->len = n;
+	s->postfix = (vector**)calloc(n ? n : 1, sizeof(vector*));
+	s->unknowns = new_varmap();
+	if (s->postfix == NULL || s->unknowns == NULL) {
+		puts("error: insufficient heap memory for new system of equations");
+		destroy_nonlinear_system(s);
+		return NULL;
+	}
+
+	size_t i = 0, nnz = 0, widest = 1;
+	for (snode* tmp = sys->head; tmp; tmp = tmp->next, i++) {
+		char* fn = functionify(tmp->data);
+		s->postfix[i] = fn ? shunting_yard(words(fn)) : NULL;
+		free(fn);
+		s->eqns[i] = s->postfix[i] ? compile_postfix(s->postfix[i]) : NULL;
+		if (s->eqns[i] == NULL) {
+			destroy_nonlinear_system(s);
+			return NULL;
+		}
+
+		// residuals and Jacobians run natively where there is a JIT
+		jit_program(s->eqns[i]);
+
+		varmap* eqvars = vars(s->postfix[i]);
+		if (eqvars == NULL) {
+			destroy_nonlinear_system(s);
+			return NULL;
+		}
+		for (size_t j = 0; j < eqvars->len; j++) {
+			if (varmap_find(s->unknowns, eqvars->vars[j].id) >= 0)
+				continue;
+			size_t len = s->unknowns->len;
+			s->unknowns = push_id_to_varmap(s->unknowns, eqvars->vars[j].id, 1);
+			if (s->unknowns->len == len) {
+				free_s(eqvars);
+				destroy_nonlinear_system(s);
+				return NULL;
+			}
+		}
+		free_s(eqvars);
+
+		nnz += s->eqns[i]->nvars;
+		if (s->eqns[i]->nvars > widest)
+			widest = s->eqns[i]->nvars;
+	}
+
+	if (s->unknowns->len != n) {
+		puts("error: system of equations is improperly constrained. (independent variable issue)");
+		printf("DOF: %zu; EQS: %zu\n", s->unknowns->len, n);
+		destroy_nonlinear_system(s);
+		return NULL;
+	}
+
+	s->pattern = new_csr(n, n, nnz);
+	s->env = (scalar*)malloc(sizeof(scalar) * 2 * widest);
+	s->grad = s->env + widest;
+	s->widest = widest;
+	if (s->pattern == NULL || s->env == NULL) {
+		puts("error: insufficient heap memory for new system of equations");
+		destroy_nonlinear_system(s);
+		return NULL;
+	}
+
+	nnz = 0;
+	for (i = 0; i < n; i++) {
+		s->pattern->rowptr[i] = nnz;
+		for (size_t k = 0; k < s->eqns[i]->nvars; k++)
+			s->pattern->colidx[nnz++] = (size_t)__varmap_slot(s->unknowns, s->eqns[i]->names[k]);
+	}
+	s->pattern->rowptr[n] = nnz;
+
+	return s;
+}
+
+/*
+Gathers the current values of equation `i`'s variables into 
+`s->env`, the environment its program reads.
+*/
+void __gather_equation(nonlinear_system* s, size_t i) {
+	csr_matrix* p = s->pattern;
+	for (size_t k = p->rowptr[i]; k < p->rowptr[i + 1]; k++)
+		s->env[k - p->rowptr[i]] = s->unknowns->vars[p->colidx[k]].val;
+}
+
+/*
+Turns evaluation through the symbolic Jacobian on or off, 
+differentiating and compiling it the first time it's turned on. 
+Returns false, leaving it off, if it can't be built.
+*/
+bool use_symbolic_jacobian(nonlinear_system* s, bool on) {
+	if (on && s->sym == NULL) {
+		s->sym = new_symbolic_jacobian(s->eqns, s->len, s->widest);
+		if (s->sym == NULL) {
+			s->symbolic = false;
+			return false;
+		}
+	}
+	s->symbolic = on;
+	return true;
+}
+
+/*
+Evaluates equation `i` at the current values of the unknowns.
+*/
+scalar __eval_equation(nonlinear_system* s, size_t i) {
+	__gather_equation(s, i);
+	if (s->symbolic)
+		return eval_symbolic_residual(s->sym, i, s->env, sizeof(scalar));
+	return run_program(s->eqns[i], s->env);
+}
+
+/*
+Evaluates the partials of equation `i` at the current values of 
+the unknowns into `s->grad`, by slot of its program.
+*/
+void __eval_equation_gradient(nonlinear_system* s, size_t i) {
+	__gather_equation(s, i);
+	if (s->symbolic)
+		eval_symbolic_row(s->sym, i, s->env, sizeof(scalar), s->grad);
+	else
+		run_program_gradient(s->eqns[i], s->env, sizeof(scalar), s->grad);
+}
+
+/*
+Evaluates every equation at the current values of the unknowns 
+into `out`, which must hold `s->len` values.
+*/
+void eval_residuals(nonlinear_system* s, scalar* out) {
+	for (size_t i = 0; i < s->len; i++)
+		out[i] = __eval_equation(s, i);
+}
+
+/*
+Evaluates the Jacobian of the system at the current values of the 
+unknowns into `out`, a matrix with the same pattern as 
+`s->pattern` (see `csr_like`). Only the structurally nonzero 
+partials are computed: one reverse sweep per row yields exactly 
+that row's nonzeros, in place.
+*/
+void eval_sparse_jacobian(nonlinear_system* s, csr_matrix* out) {
+	for (size_t i = 0; i < s->len; i++) {
+		if (!s->symbolic) {
+			__gather_equation(s, i);
+			run_program_gradient(s->eqns[i], s->env, sizeof(scalar), &out->vals[out->rowptr[i]]);
+			continue;
+		}
+		__eval_equation_gradient(s, i);
+		for (size_t k = out->rowptr[i]; k < out->rowptr[i + 1]; k++)
+			out->vals[k] = s->grad[k - out->rowptr[i]];
+	}
+}
+
+/*
+Evaluates the Jacobian of the system at the current values of the 
+unknowns into the dense `s->len` x `s->len` matrix `out`.
+*/
+void eval_jacobian(nonlinear_system* s, matrix* out) {
+	csr_matrix* p = s->pattern;
+	for (size_t i = 0; i < s->len; i++) {
+		scalar* row = &mac(out, i, 0);
+		for (size_t j = 0; j < s->len; j++)
+			row[j] = 0;
+
+		__eval_equation_gradient(s, i);
+		for (size_t k = p->rowptr[i]; k < p->rowptr[i + 1]; k++)
+			row[p->colidx[k]] = s->grad[k - p->rowptr[i]];
+	}
+}
+
+/*
+A square piece of a system, solved as one Newton problem: equation 
+`rows[b]` for unknown `cols[b]`, for every `b` below `len`, with 
+every other unknown held at its current value. `pattern` is the 
+Jacobian restricted to the block, its rows and columns numbered by 
+position in `rows` and `cols`, and its entry `e` is the partial at 
+slot `slot[e]` of its equation's program. `color` colors the 
+columns of `pattern` with `ncolors` colors, and the block columns 
+of color `c` are `group[group_ptr[c]]` to 
+`group[group_ptr[c + 1] - 1]`. Everything but `pattern` is one 
+allocation.
+*/
+typedef struct {
+	size_t len;
+	size_t* rows;
+	size_t* cols;
+	csr_matrix* pattern;
+	size_t* slot;
+	size_t ncolors;
+	size_t* color;
+	size_t* group;
+	size_t* group_ptr;
+} newton_block;
+
+void destroy_newton_block(newton_block* b) {
+	if (b->pattern)
+		destroy_csr(b->pattern);
+	free(b);
+	b = NULL;
+}
+
+/*
+Creates the block of `s` that solves equations `rows` for unknowns 
+`cols`, both of length `len`. `local` is scratch space of `s->len` 
+values that must all be SIZE_MAX, and are again on return; it 
+keeps building a block proportional to the block's size rather 
+than the system's.
+*/
+newton_block* new_newton_block(nonlinear_system* s, const size_t* rows, const size_t* cols, size_t len, size_t* local) {
+	csr_matrix* p = s->pattern;
+	for (size_t b = 0; b < len; b++)
+		local[cols[b]] = b;
+
+	size_t nnz = 0;
+	for (size_t b = 0; b < len; b++)
+		for (size_t k = p->rowptr[rows[b]]; k < p->rowptr[rows[b] + 1]; k++)
+			nnz += local[p->colidx[k]] != SIZE_MAX;
+
+	newton_block* blk = (newton_block*)calloc(1, sizeof(newton_block) + sizeof(size_t) * (5 * len + 1 + nnz));
+	csr_matrix* bp = blk ? new_csr(len, len, nnz) : NULL;
+	if (bp == NULL) {
+		puts("error: insufficient heap memory for new newton block");
+		free(blk);
+		for (size_t b = 0; b < len; b++)
+			local[cols[b]] = SIZE_MAX;
+		return NULL;
+	}
+	blk->len = len;
+	blk->pattern = bp;
+	blk->rows = (size_t*)(blk + 1);
+	blk->cols = blk->rows + len;
+	blk->color = blk->cols + len;
+	blk->group = blk->color + len;
+	blk->group_ptr = blk->group + len;
+	blk->slot = blk->group_ptr + len + 1;
+	for (size_t b = 0; b < len; b++) {
+		blk->rows[b] = rows[b];
+		blk->cols[b] = cols[b];
+	}
+
+	nnz = 0;
+	for (size_t b = 0; b < len; b++) {
+		bp->rowptr[b] = nnz;
+		for (size_t k = p->rowptr[rows[b]]; k < p->rowptr[rows[b] + 1]; k++) {
+			if (local[p->colidx[k]] == SIZE_MAX)
+				continue;
+			bp->colidx[nnz] = local[p->colidx[k]];
+			blk->slot[nnz] = k - p->rowptr[rows[b]];
+			nnz++;
+		}
+	}
+	bp->rowptr[len] = nnz;
+	for (size_t b = 0; b < len; b++)
+		local[cols[b]] = SIZE_MAX;
+
+	// group the block's unknowns by color
+	blk->ncolors = csr_color_columns(bp, blk->color);
+	if (blk->ncolors == 0 && len > 0) {
+		destroy_newton_block(blk);
+		return NULL;
+	}
+	for (size_t c = 0; c <= blk->ncolors; c++)
+		blk->group_ptr[c] = 0;
+	for (size_t b = 0; b < len; b++)
+		blk->group_ptr[blk->color[b] + 1]++;
+	for (size_t c = 0; c < blk->ncolors; c++)
+		blk->group_ptr[c + 1] += blk->group_ptr[c];
+	for (size_t b = 0; b < len; b++)
+		blk->group[blk->group_ptr[blk->color[b]]++] = b;
+	for (size_t c = blk->ncolors; c > 0; c--)
+		blk->group_ptr[c] = blk->group_ptr[c - 1];
+	blk->group_ptr[0] = 0;
+	return blk;
+}
+
+/*
+Evaluates the equations of block `blk` at the current values of 
+the unknowns into `out`, which must hold `blk->len` values.
+*/
+void eval_block_residuals(nonlinear_system* s, newton_block* blk, scalar* out) {
+	for (size_t b = 0; b < blk->len; b++)
+		out[b] = __eval_equation(s, blk->rows[b]);
+}
+
+/*
+Evaluates the Jacobian of block `blk` at the current values of the 
+unknowns into `out`, a matrix with the same pattern as 
+`blk->pattern`, with one reverse sweep (or symbolic row) per 
+equation.
+*/
+void eval_block_jacobian(nonlinear_system* s, newton_block* blk, csr_matrix* out) {
+	for (size_t b = 0; b < blk->len; b++) {
+		__eval_equation_gradient(s, blk->rows[b]);
+		for (size_t e = out->rowptr[b]; e < out->rowptr[b + 1]; e++)
+			out->vals[e] = s->grad[blk->slot[e]];
+	}
+}
+
+/*
+Estimates the Jacobian of block `blk` at the current values of the 
+unknowns, where its residuals are `f`, by forward differences into 
+`out`, a matrix with the same pattern as `blk->pattern`. All the 
+unknowns of one color are perturbed together, and only the 
+equations that read one of them are re-evaluated, so the whole 
+Jacobian costs `blk->ncolors` partial residual sweeps instead of 
+one full sweep per unknown. `work` must hold `blk->len` values.
+*/
+void eval_block_fd_jacobian(nonlinear_system* s, newton_block* blk, const scalar* f, csr_matrix* out, scalar* work) {
+	vardef* x = s->unknowns->vars;
+	scalar rel = smath(sqrt)(SCALAR_EPSILON);
+
+	for (size_t c = 0; c < blk->ncolors; c++) {
+		for (size_t g = blk->group_ptr[c]; g < blk->group_ptr[c + 1]; g++) {
+			size_t j = blk->group[g];
+			vardef* v = &x[blk->cols[j]];
+			scalar mag = smath(fabs)(v->val);
+			work[j] = v->val;
+			v->val += rel * (mag > 1 ? mag : 1);
+		}
+
+		for (size_t b = 0; b < blk->len; b++) {
+			bool touched = false;
+			for (size_t e = out->rowptr[b]; e < out->rowptr[b + 1] && !touched; e++)
+				touched = blk->color[out->colidx[e]] == c;
+			if (!touched)
+				continue;
+
+			scalar fb = __eval_equation(s, blk->rows[b]);
+
+			// no other unknown of this color appears in the equation
+			for (size_t e = out->rowptr[b]; e < out->rowptr[b + 1]; e++) {
+				size_t j = out->colidx[e];
+				if (blk->color[j] == c)
+					out->vals[e] = (fb - f[b]) / (x[blk->cols[j]].val - work[j]);
+			}
+		}
+
+		for (size_t g = blk->group_ptr[c]; g < blk->group_ptr[c + 1]; g++)
+			x[blk->cols[blk->group[g]]].val = work[blk->group[g]];
+	}
+}
+
+typedef enum {
+	NEWTON_CONVERGED,	// residual within tolerance
+	NEWTON_MAX_ITER,	// ran out of iterations
+	NEWTON_STALLED,		// the line search couldn't reduce the residual
+	NEWTON_SINGULAR,	// the Jacobian couldn't be factored
+	NEWTON_FAILED		// the system couldn't be set up or memory ran out
+} newton_status;
+
+typedef enum {
+	NEWTON_EXACT,	// factor the exact Jacobian every iteration
+	NEWTON_BROYDEN	// rank-1 updates of an approximate inverse Jacobian
+} newton_method;
+
+/*
+What one Newton iteration did. `block` is the block it worked on 
+(always 0 unless the system was decomposed). `residual` and `step` 
+are max-norms over that block after the iteration; `damping` is 
+the fraction of the full Newton step the line search accepted and 
+`jacobians` the number of exact Jacobians evaluated.
+*/
+typedef struct {
+	size_t iter;
+	size_t block;
+	scalar residual;
+	scalar step;
+	scalar damping;
+	size_t backtracks;
+	size_t evals;
+	size_t jacobians;
+} newton_stats;
+
+typedef void (*newton_monitor)(const newton_stats* stats, void* ctx);
+
+/*
+Controls `newton_solve`:
+
+	tol				stop once every residual is within `tol`
+	step_tol		stop once a step moves every unknown by less 
+					than `step_tol` relative to its magnitude
+	max_iter		give up after this many iterations (per block)
+	max_backtracks	halve a step at most this many times before 
+					declaring the iteration stalled
+	armijo			sufficient decrease the line search asks of 
+					0.5 |F|^2 per unit step
+	method			exact Newton or Broyden
+	sparse			factor the Jacobian with `sparse_lu_decompose` 
+					instead of as a dense matrix
+	finite_diff		estimate the Jacobian by forward differences, a 
+					color group of columns per residual sweep, 
+					instead of differentiating exactly
+	symbolic		differentiate the equations symbolically once 
+					(see `new_symbolic_jacobian`) and evaluate 
+					residuals and exact Jacobians from the result, 
+					with repeated subterms computed once, instead 
+					of running the compiled equations
+	decompose		split the system into its block lower 
+					triangular form first and solve the blocks one 
+					after another
+	refresh			for Broyden, rebuild the inverse Jacobian from 
+					the exact one every `refresh` iterations (0 
+					only rebuilds it when the updates stop working)
+	monitor			if not NULL, called with `ctx` after every 
+					iteration
+*/
+typedef struct {
+	scalar tol;
+	scalar step_tol;
+	size_t max_iter;
+	size_t max_backtracks;
+	scalar armijo;
+	newton_method method;
+	bool sparse;
+	bool finite_diff;
+	bool symbolic;
+	bool decompose;
+	size_t refresh;
+	newton_monitor monitor;
+	void* ctx;
+} newton_options;
+
+newton_options newton_defaults(void) {
+	return (newton_options) {
+		.tol = smath(sqrt)(SCALAR_EPSILON) * (scalar)1e-2,
+		.step_tol = SCALAR_EPSILON * 16,
+		.max_iter = 50,
+		.max_backtracks = 30,
+		.armijo = (scalar)1e-4,
+		.method = NEWTON_EXACT,
+		.sparse = true,
+		.finite_diff = false,
+		.symbolic = false,
+		.decompose = true,
+		.refresh = 10,
+		.monitor = NULL,
+		.ctx = NULL
+	};
+}
+
+/*
+Returns the largest magnitude in `v`, or NaN if `v` has a NaN.
+*/
+scalar __max_norm(const scalar* v, size_t n) {
+	scalar res = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (isnan(v[i]))
+			return v[i];
+		if (smath(fabs)(v[i]) > res)
+			res = smath(fabs)(v[i]);
+	}
+	return res;
+}
+
+scalar __half_sq_norm(const scalar* v, size_t n) {
+	scalar res = 0;
+	for (size_t i = 0; i < n; i++)
+		res += v[i] * v[i];
+	return res / 2;
+}
+
+/*
+Writes the quasi-Newton direction `-H f` to `dx`.
+*/
+void __broyden_direction(matrix* inv, const scalar* f, scalar* dx) {
+	for (size_t j = 0; j < inv->rows; j++) {
+		scalar* row = &mac(inv, j, 0);
+		scalar sum = 0;
+		for (size_t i = 0; i < inv->cols; i++)
+			sum += row[i] * f[i];
+		dx[j] = -sum;
+	}
+}
+
+/*
+Evaluates the Jacobian of block `blk` (exactly, or by colored 
+finite differences if `fd`) into `sjac`, factors it, sparse, or 
+dense through `jac` if `jac` isn't NULL, and writes the Newton 
+direction `-J^-1 f` to `dx`. With `inv` non-NULL the direction goes 
+through an explicit inverse, which is kept in `*inv` for Broyden 
+updates; otherwise `J` is only factored. `work` must hold 
+3 * `blk->len` values. Returns false if `J` is singular.
+*/
+bool __newton_direction(nonlinear_system* s, newton_block* blk, matrix* jac, csr_matrix* sjac, 
+	matrix** inv, const scalar* f, scalar* dx, scalar* work, bool fd) {
+	size_t n = blk->len;
+
+	if (fd)
+		eval_block_fd_jacobian(s, blk, f, sjac, work);
+	else
+		eval_block_jacobian(s, blk, sjac);
+
+	if (jac == NULL) {
+		sparse_lu* lu = sparse_lu_decompose(sjac);
+		if (lu == NULL)
+			return false;
+
+		if (inv) {
+			// the inverse one column at a time, as J^-1 e_k
+			if (*inv == NULL)
+				*inv = new_nxn(n);
+			if (*inv) {
+				scalar* e = work + n;
+				scalar* col = work + 2 * n;
+				for (size_t i = 0; i < n; i++)
+					e[i] = 0;
+				for (size_t k = 0; k < n; k++) {
+					e[k] = 1;
+					__sparse_lu_substitute(lu, e, col, work);
+					e[k] = 0;
+					for (size_t j = 0; j < n; j++)
+						mac(*inv, j, k) = col[j];
+				}
+			}
+		}
+		else
+			__sparse_lu_substitute(lu, f, dx, work);
+		destroy_sparse_lu(lu);
+	}
+	else {
+		for (size_t j = 0; j < n; j++) {
+			for (size_t i = 0; i < n; i++)
+				mac(jac, j, i) = 0;
+			for (size_t k = sjac->rowptr[j]; k < sjac->rowptr[j + 1]; k++)
+				mac(jac, j, sjac->colidx[k]) = sjac->vals[k];
+		}
+		lu_factors* lu = lu_decompose(jac);
+		if (lu == NULL)
+			return false;
+
+		if (inv) {
+			if (*inv)
+				destroy_matrix(*inv);
+			*inv = lu_inverse(lu);
+		}
+		else
+			__lu_substitute(lu, f, dx);
+		destroy_lu(lu);
+	}
+
+	if (inv) {
+		if (*inv == NULL)
+			return false;
+		__broyden_direction(*inv, f, dx);
+	}
+	else {
+		for (size_t i = 0; i < n; i++)
+			dx[i] = -dx[i];
+	}
+	return true;
+}
+
+/*
+Applies Broyden's ("good") rank-1 update to the approximate inverse 
+Jacobian `inv` after a step `dx` changed the residuals by `df`:
+
+	H += (dx - H df) (dx^T H) / (dx^T H df)
+
+so the updated `H` maps `df` back onto `dx`. `work` must hold 
+2 * n values. This is O(n^2). Returns false, leaving `inv` alone, 
+if the update is numerically degenerate.
+*/
+bool __broyden_update(matrix* inv, const scalar* dx, const scalar* df, scalar* work) {
+	size_t n = inv->rows;
+	scalar* hdf = work;
+	scalar* dxh = work + n;
+
+	for (size_t i = 0; i < n; i++)
+		dxh[i] = 0;
+
+	scalar denom = 0, dxn = 0, hdfn = 0;
+	for (size_t j = 0; j < n; j++) {
+		scalar* row = &mac(inv, j, 0);
+		scalar sum = 0;
+		for (size_t i = 0; i < n; i++)
+			sum += row[i] * df[i];
+		hdf[j] = sum;
+		scalar_fn(vec_axpy)(dxh, row, dx[j], n);
+
+		denom += dx[j] * sum;
+		dxn += dx[j] * dx[j];
+		hdfn += sum * sum;
+	}
+
+	if (!(smath(fabs)(denom) > SCALAR_EPSILON * smath(sqrt)(dxn * hdfn)))
+		return false;
+
+	for (size_t j = 0; j < n; j++)
+		scalar_fn(vec_axpy)(&mac(inv, j, 0), dxh, (dx[j] - hdf[j]) / denom, n);
+	return true;
+}
+
+/*
+Runs damped Newton iterations on one block of `s`, moving only the 
+block's unknowns, and adds what it did to `total`. See 
+`newton_solve`.
+*/
+newton_status __newton_solve_block(nonlinear_system* s, newton_block* blk, size_t index, 
+	newton_options* o, newton_stats* total) {
+	size_t n = blk->len;
+	vardef* x = s->unknowns->vars;
+	bool broyden = o->method == NEWTON_BROYDEN;
+	newton_status status = NEWTON_MAX_ITER;
+	size_t iters = 0;
+
+	matrix* jac = o->sparse ? NULL : new_nxn(n);
+	csr_matrix* sjac = csr_like(blk->pattern);
+	matrix* inv = NULL;
+	scalar* work = (scalar*)malloc(sizeof(scalar) * (8 * n + 1));
+	if ((!o->sparse && jac == NULL) || sjac == NULL || work == NULL) {
+		puts("error: insufficient heap memory for newton solve");
+		status = NEWTON_FAILED;
+		goto done;
+	}
+	scalar* f = work;
+	scalar* trial = work + n;
+	scalar* x0 = work + 2 * n;
+	scalar* dx = work + 3 * n;
+	scalar* df = work + 4 * n;
+	scalar* scratch = work + 5 * n;	// 3 * n
+
+	eval_block_residuals(s, blk, f);
+	total->evals++;
+	scalar residual = __max_norm(f, n);
+	scalar merit = __half_sq_norm(f, n);
+
+	bool stale = true;	// the Broyden inverse needs rebuilding
+	size_t age = 0;		// iterations since it was last rebuilt
+
+	while (true) {
+		if (residual <= o->tol) {
+			status = NEWTON_CONVERGED;
+			break;
+		}
+		if (iters >= o->max_iter) {
+			status = NEWTON_MAX_ITER;
+			break;
+		}
+
+		newton_stats it = { total->iter + 1, index, 0, 0, 1, 0, 0, 0 };
+
+		bool fresh = !broyden || stale || (o->refresh && age >= o->refresh);
+		if (fresh) {
+			it.jacobians++;
+			if (!__newton_direction(s, blk, jac, sjac, broyden ? &inv : NULL, f, dx, scratch, o->finite_diff)) {
+				total->jacobians += it.jacobians;
+				status = NEWTON_SINGULAR;
+				break;
+			}
+			if (o->finite_diff)
+				it.evals += blk->ncolors;
+			stale = false;
+			age = 0;
+		}
+		else
+			__broyden_direction(inv, f, dx);
+
+		for (size_t i = 0; i < n; i++)
+			x0[i] = x[blk->cols[i]].val;
+
+		// backtrack until the merit function decreases enough; along 
+		// the Newton direction its slope is -2 * merit
+		bool accepted = false;
+		scalar t = 1;
+		for (size_t b = 0; b <= o->max_backtracks; b++) {
+			for (size_t i = 0; i < n; i++)
+				x[blk->cols[i]].val = x0[i] + t * dx[i];
+			eval_block_residuals(s, blk, trial);
+			it.evals++;
+
+			scalar m = __half_sq_norm(trial, n);
+			if (m <= (1 - 2 * o->armijo * t) * merit) {
+				accepted = true;
+				merit = m;
+				break;
+			}
+			it.backtracks++;
+			t /= 2;
+		}
+
+		scalar step = 0, scale = 0;
+		for (size_t i = 0; i < n; i++) {
+			scalar d = smath(fabs)(t * dx[i]);
+			scalar a = smath(fabs)(x0[i]);
+			step = d > step ? d : step;
+			scale = a > scale ? a : scale;
+		}
+
+		total->backtracks += it.backtracks;
+		total->evals += it.evals;
+		total->jacobians += it.jacobians;
+
+		if (!accepted) {
+			for (size_t i = 0; i < n; i++)
+				x[blk->cols[i]].val = x0[i];
+
+			// an approximate Jacobian gets one retry with the exact one
+			if (!fresh) {
+				stale = true;
+				continue;
+			}
+			status = NEWTON_STALLED;
+			break;
+		}
+
+		if (broyden) {
+			for (size_t i = 0; i < n; i++) {
+				dx[i] *= t;
+				df[i] = trial[i] - f[i];
+			}
+			if (!__broyden_update(inv, dx, df, scratch))
+				stale = true;
+			age++;
+		}
+
+		for (size_t i = 0; i < n; i++)
+			f[i] = trial[i];
+		residual = __max_norm(f, n);
+		iters++;
+
+		it.residual = residual;
+		it.step = step;
+		it.damping = t;
+		total->iter = it.iter;
+		total->step = it.step;
+		total->damping = it.damping;
+
+		if (o->monitor)
+			o->monitor(&it, o->ctx);
+
+		if (residual > o->tol && step <= o->step_tol * (1 + scale)) {
+			if (!fresh) {
+				stale = true;
+				continue;
+			}
+			status = NEWTON_STALLED;
+			break;
+		}
+	}
+
+done:
+	if (jac)
+		destroy_matrix(jac);
+	if (sjac)
+		destroy_csr(sjac);
+	if (inv)
+		destroy_matrix(inv);
+	free(work);
+	return status;
+}
+
+/*
+Solves `s` in place with damped Newton iterations, starting from 
+the current values of `s->unknowns`. Each iteration takes a Newton 
+step and backtracks along it until 0.5 |F|^2 decreases 
+sufficiently.
+
+With `decompose`, the system is first permuted to block lower 
+triangular form (see `csr_block_triangularize`), and each block is 
+solved on its own, in order, for its own unknowns with the 
+unknowns of earlier blocks already fixed at their solution. The 
+Jacobians factored are then only as big as the blocks.
+
+With `NEWTON_EXACT` every step factors the exact Jacobian. With 
+`NEWTON_BROYDEN` the exact Jacobian is only evaluated and inverted 
+on a block's first iteration, every `refresh` iterations, and 
+whenever the approximate one fails to give a step the line search 
+accepts; in between, the inverse gets rank-1 updates, so an 
+iteration costs O(n^2) and a single residual sweep.
+
+`summary`, if not NULL, receives the totals over the whole solve 
+(`iter` is the iteration count, `residual` the max-norm over every 
+equation at the end, `block` the number of blocks; `backtracks`, 
+`evals` and `jacobians` are summed).
+*/
+newton_status newton_solve(nonlinear_system* s, newton_options* opts, newton_stats* summary) {
+	newton_options o = opts ? *opts : newton_defaults();
+	size_t n = s->len;
+
+	newton_stats total = { 0, 0, 0, 0, 1, 0, 0, 0 };
+	newton_status status = NEWTON_CONVERGED;
+
+	size_t* buf = (size_t*)malloc(sizeof(size_t) * (4 * n + 2));
+	scalar* f = (scalar*)malloc(sizeof(scalar) * (n + 1));
+	if (buf == NULL || f == NULL) {
+		puts("error: insufficient heap memory for newton solve");
+		status = NEWTON_FAILED;
+		goto done;
+	}
+	if (!use_symbolic_jacobian(s, o.symbolic)) {
+		status = NEWTON_FAILED;
+		goto done;
+	}
+	size_t* rows = buf;
+	size_t* cols = buf + n;
+	size_t* blockptr = buf + 2 * n;
+	size_t* local = buf + 3 * n + 1;
+
+	size_t nblocks = 1;
+	if (o.decompose && n > 0) {
+		nblocks = csr_block_triangularize(s->pattern, rows, cols, blockptr);
+		if (nblocks == 0) {
+			status = NEWTON_SINGULAR;
+			goto done;
+		}
+	}
+	else {
+		for (size_t i = 0; i < n; i++)
+			rows[i] = cols[i] = i;
+		blockptr[0] = 0;
+		blockptr[1] = n;
+	}
+	for (size_t i = 0; i < n; i++)
+		local[i] = SIZE_MAX;
+
+	for (size_t b = 0; b < nblocks && status == NEWTON_CONVERGED; b++) {
+		size_t lo = blockptr[b], len = blockptr[b + 1] - lo;
+		newton_block* blk = new_newton_block(s, rows + lo, cols + lo, len, local);
+		if (blk == NULL) {
+			status = NEWTON_FAILED;
+			break;
+		}
+		status = __newton_solve_block(s, blk, b, &o, &total);
+		destroy_newton_block(blk);
+	}
+	total.block = nblocks;
+
+	eval_residuals(s, f);
+	total.evals++;
+	total.residual = __max_norm(f, n);
+
+done:
+	free(buf);
+	free(f);
+	if (summary)
+		*summary = total;
+	return status;
+}
+
+/*
+Solves a system of equation strings (`lhs = rhs`, one per node of 
+`sys`) with Newton's method and returns a new varmap of the 
+solution, or NULL if the solve doesn't converge. Unknowns start at 
+their value in `guess` when it has them (`guess` may be NULL) and 
+at 1 otherwise. `opts` may be NULL for `newton_defaults()`, and 
+`summary`, if not NULL, receives the totals of the solve. The 
+returned varmap owns its names and is released with `free`.
+*/
+varmap* solve_system(DoublyLinkedList* sys, varmap* guess, newton_options* opts, newton_stats* summary) {
+	nonlinear_system* s = new_nonlinear_system(sys);
+	if (s == NULL) {
+		if (summary)
+			*summary = (newton_stats){ 0 };
+		return NULL;
+	}
+
+	if (guess) {
+		for (size_t i = 0; i < s->unknowns->len; i++) {
+			long slot = __varmap_slot(guess, s->unknowns->vars[i].name);
+			if (slot >= 0)
+				s->unknowns->vars[i].val = guess->vars[slot].val;
+		}
+	}
+
+	newton_status status = newton_solve(s, opts, summary);
+	varmap* res = NULL;
+	if (status == NEWTON_CONVERGED)
+		res = copy_varmap(s->unknowns);
+	else
+		printf("error: newton solve did not converge (status %d)\n", (int)status);
+
+	destroy_nonlinear_system(s);
+	return res;
+}
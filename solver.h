@@ -0,0 +1,124 @@
+#pragma once
+#include <stdlib.h>
+#include <stdbool.h>
+#include "precision.h"
+#include "clinalg.h"
+#include "dlinklist.h"
+#include "bytecode.h"
+#include "stupidmath.h"
+#include "symbolic.h"
+
+typedef struct {
+	size_t len;
+	varmap* unknowns;
+	vector** postfix;
+	csr_matrix* pattern;
+	scalar* env;
+	scalar* grad;
+	size_t widest;
+	symbolic_jacobian* sym;
+	bool symbolic;
+	program* eqns[];
+} nonlinear_system;
+
+nonlinear_system* new_nonlinear_system(DoublyLinkedList* sys);
+
+void destroy_nonlinear_system(nonlinear_system* s);
+
+void __gather_equation(nonlinear_system* s, size_t i);
+
+bool use_symbolic_jacobian(nonlinear_system* s, bool on);
+
+scalar __eval_equation(nonlinear_system* s, size_t i);
+
+void __eval_equation_gradient(nonlinear_system* s, size_t i);
+
+void eval_residuals(nonlinear_system* s, scalar* out);
+
+void eval_sparse_jacobian(nonlinear_system* s, csr_matrix* out);
+
+void eval_jacobian(nonlinear_system* s, matrix* out);
+
+typedef struct {
+	size_t len;
+	size_t* rows;
+	size_t* cols;
+	csr_matrix* pattern;
+	size_t* slot;
+	size_t ncolors;
+	size_t* color;
+	size_t* group;
+	size_t* group_ptr;
+} newton_block;
+
+newton_block* new_newton_block(nonlinear_system* s, const size_t* rows, const size_t* cols, size_t len, size_t* local);
+
+void destroy_newton_block(newton_block* b);
+
+void eval_block_residuals(nonlinear_system* s, newton_block* blk, scalar* out);
+
+void eval_block_jacobian(nonlinear_system* s, newton_block* blk, csr_matrix* out);
+
+void eval_block_fd_jacobian(nonlinear_system* s, newton_block* blk, const scalar* f, csr_matrix* out, scalar* work);
+
+typedef enum {
+	NEWTON_CONVERGED,
+	NEWTON_MAX_ITER,
+	NEWTON_STALLED,
+	NEWTON_SINGULAR,
+	NEWTON_FAILED
+} newton_status;
+
+typedef enum {
+	NEWTON_EXACT,
+	NEWTON_BROYDEN
+} newton_method;
+
+typedef struct {
+	size_t iter;
+	size_t block;
+	scalar residual;
+	scalar step;
+	scalar damping;
+	size_t backtracks;
+	size_t evals;
+	size_t jacobians;
+} newton_stats;
+
+typedef void (*newton_monitor)(const newton_stats* stats, void* ctx);
+
+typedef struct {
+	scalar tol;
+	scalar step_tol;
+	size_t max_iter;
+	size_t max_backtracks;
+	scalar armijo;
+	newton_method method;
+	bool sparse;
+	bool finite_diff;
+	bool symbolic;
+	bool decompose;
+	size_t refresh;
+	newton_monitor monitor;
+	void* ctx;
+} newton_options;
+
+newton_options newton_defaults(void);
+
+scalar __max_norm(const scalar* v, size_t n);
+
+scalar __half_sq_norm(const scalar* v, size_t n);
+
+void __broyden_direction(matrix* inv, const scalar* f, scalar* dx);
+
+bool __newton_direction(nonlinear_system* s, newton_block* blk, matrix* jac, csr_matrix* sjac, 
+	matrix** inv, const scalar* f, scalar* dx, scalar* work, bool fd);
+
+bool __broyden_update(matrix* inv, const scalar* dx, const scalar* df, scalar* work);
+
+newton_status __newton_solve_block(nonlinear_system* s, newton_block* blk, size_t index, 
+	newton_options* o, newton_stats* total);
+
+newton_status newton_solve(nonlinear_system* s, newton_options* opts, newton_stats* summary);
+
+varmap* solve_system(DoublyLinkedList* sys, varmap* guess, newton_options* opts, newton_stats* summary);
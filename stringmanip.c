@@ -2,6 +2,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 bool __strcmp_g_inplace(char* start, char* target) {
 	if (start == NULL || target == NULL)
@@ -69,4 +70,150 @@ char* replace(char* string, char* from, char* to) {
 	}
 	
 	return res;
-}
\ No newline at end of file
+}
+
+/*
+64-bit FNV-1a hash of the `len` chars at `s`.
+*/
+size_t hash_bytes(const char* s, size_t len) {
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < len; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 1099511628211ULL;
+	}
+	return (size_t)h;
+}
+
+/*
+64-bit FNV-1a hash of a nul-terminated string.
+*/
+size_t hash_string(const char* s) {
+	return hash_bytes(s, strlen(s));
+}
+
+/*
+Mixes an integer key (such as an interned name id) into a hash 
+with Fibonacci hashing, so that consecutive keys spread across an 
+open-addressing table instead of clustering.
+*/
+size_t hash_id(size_t id) {
+	return (size_t)(((uint64_t)id + 1) * 11400714819323198485ULL >> 17);
+}
+
+/*
+The process-wide table of interned names. Every distinct name gets 
+a small integer id, handed out in order of first interning, and 
+one owned copy of its spelling in `names[id]`, so two interned 
+names are equal exactly when their ids (or pointers) are. `index` 
+is an open-addressing table of `2 * cap` slots, linearly probed, 
+holding `id + 1` (0 marks an empty slot). Interning is not 
+thread-safe.
+*/
+typedef struct {
+	size_t len;
+	size_t cap;
+	char** names;
+	size_t* index;
+} intern_table;
+
+intern_table interned = { 0, 0, NULL, NULL };
+
+/*
+Returns the index slot where the `len` chars of `name` (with hash 
+`h`) are, or the empty slot where they would go.
+*/
+size_t __intern_probe(const char* name, size_t len, size_t h) {
+	size_t mask = 2 * interned.cap - 1;
+	size_t i = h & mask;
+	while (interned.index[i]) {
+		char* have = interned.names[interned.index[i] - 1];
+		if (strncmp(have, name, len) == 0 && have[len] == '\0')
+			break;
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+/*
+Doubles the intern table's capacity and rehashes its index.
+*/
+bool __grow_interned(void) {
+	size_t cap = interned.cap ? 2 * interned.cap : 64;
+	char** names = (char**)realloc(interned.names, sizeof(char*) * cap);
+	if (!names)
+		return false;
+	interned.names = names;
+
+	size_t* index = (size_t*)calloc(2 * cap, sizeof(size_t));
+	if (!index)
+		return false;
+	free(interned.index);
+	interned.index = index;
+	interned.cap = cap;
+
+	for (size_t id = 0; id < interned.len; id++) {
+		size_t len = strlen(interned.names[id]);
+		index[__intern_probe(interned.names[id], len, hash_bytes(interned.names[id], len))] = id + 1;
+	}
+	return true;
+}
+
+/*
+Returns the id of the name spelled by the `len` chars at `name` 
+(which needn't be nul-terminated), interning a copy of it if it 
+hasn't been seen before, or SIZE_MAX if there isn't the memory to.
+*/
+size_t intern_n(const char* name, size_t len) {
+	size_t h = hash_bytes(name, len);
+	if (interned.cap) {
+		size_t i = __intern_probe(name, len, h);
+		if (interned.index[i])
+			return interned.index[i] - 1;
+	}
+
+	if (interned.len == interned.cap && !__grow_interned()) {
+		puts("error: insufficient heap memory to intern name");
+		return SIZE_MAX;
+	}
+
+	char* copy = (char*)malloc(len + 1);
+	if (!copy) {
+		puts("error: insufficient heap memory to intern name");
+		return SIZE_MAX;
+	}
+	memcpy(copy, name, len);
+	copy[len] = '\0';
+
+	size_t id = interned.len++;
+	interned.names[id] = copy;
+	interned.index[__intern_probe(name, len, h)] = id + 1;
+	return id;
+}
+
+/*
+Returns the id of `name`, interning a copy of it if it hasn't been 
+seen before, or SIZE_MAX if there isn't the memory to.
+*/
+size_t intern(const char* name) {
+	return intern_n(name, strlen(name));
+}
+
+/*
+Returns the id of `name` if it has been interned, or SIZE_MAX if 
+it hasn't (in which case no varmap or program can hold it).
+*/
+size_t find_interned(const char* name) {
+	if (!interned.cap)
+		return SIZE_MAX;
+	size_t len = strlen(name);
+	size_t i = __intern_probe(name, len, hash_bytes(name, len));
+	return interned.index[i] ? interned.index[i] - 1 : SIZE_MAX;
+}
+
+/*
+Returns the interned spelling of name `id`. It stays valid, and 
+unchanged, for the rest of the process.
+*/
+char* interned_name(size_t id) {
+	return id < interned.len ? interned.names[id] : NULL;
+}
@@ -6,4 +6,18 @@ bool __strcmp_g_inplace(char* start, char* target);
 
 size_t instances(char* string, char* match);
 
-char* replace(char* string, char* from, char* to);
\ No newline at end of file
+char* replace(char* string, char* from, char* to);
+
+size_t hash_bytes(const char* s, size_t len);
+
+size_t hash_string(const char* s);
+
+size_t hash_id(size_t id);
+
+size_t intern_n(const char* name, size_t len);
+
+size_t intern(const char* name);
+
+size_t find_interned(const char* name);
+
+char* interned_name(size_t id);
\ No newline at end of file
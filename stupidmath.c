@@ -1,10 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include "precision.h"
 #include "clinalg.h"
 #include "shunting.h"
 #include "dlinklist.h"
 #include "stringmanip.h"
+#include "bytecode.h"
+#include "lexer.h"
 
 /*
 `Safe` free
@@ -15,61 +19,150 @@ Frees the pointer at `x` and sets its value to NULL
 
 typedef struct {
 	char* name;
-	long double val;
+	scalar val;
+	size_t id;
 } vardef;
 
+/*
+A varmap's variables live contiguously in `vars`, in the order they 
+were pushed, with room for `cap` of them. Right behind them, in the 
+same allocation, is an open-addressing index of `2 * cap` slots 
+keyed by each variable's interned name id (see `intern`) and 
+holding its position + 1, so a lookup is one hash and a short 
+linear probe instead of a scan over every name.
+*/
 typedef struct {
 	size_t len;
+	size_t cap;
 	vardef vars[];
 } varmap;
 
+size_t* __varmap_index(varmap* vm) {
+	return (size_t*)(vm->vars + vm->cap);
+}
+
+size_t __varmap_bytes(size_t cap) {
+	return sizeof(varmap) + sizeof(vardef) * cap + sizeof(size_t) * 2 * cap;
+}
+
+/*
+Returns the index slot where name `id` is, or the empty slot 
+where it would go.
+*/
+size_t __varmap_probe(varmap* vm, size_t id) {
+	size_t* index = __varmap_index(vm);
+	size_t mask = 2 * vm->cap - 1;
+	size_t i = hash_id(id) & mask;
+	while (index[i] && vm->vars[index[i] - 1].id != id)
+		i = (i + 1) & mask;
+	return i;
+}
+
+/*
+Clears the index of `vm` and refills it from `vars`. A name pushed 
+more than once is indexed at its first position.
+*/
+void __reindex_varmap(varmap* vm) {
+	memset(__varmap_index(vm), 0, sizeof(size_t) * 2 * vm->cap);
+	for (size_t i = 0; i < vm->len; i++) {
+		size_t slot = __varmap_probe(vm, vm->vars[i].id);
+		if (!__varmap_index(vm)[slot])
+			__varmap_index(vm)[slot] = i + 1;
+	}
+}
+
 /*
 Creates a new varmap pointer, returning NULL if it fails.
 
 A varmap holds key-value pairs of the string-represented 
 variables in a system of equations. I.e. binding a variable
-`deltaTime` to a long double value `0.0001`.
+`deltaTime` to a scalar value `0.0001`.
 */
 varmap* new_varmap(void) {
-	varmap* res = (varmap*)malloc(sizeof(varmap));
+	size_t cap = 8;
+	varmap* res = (varmap*)calloc(1, __varmap_bytes(cap));
 	if (!res) {
 		puts("error: insufficient heap memory for new varmap");
 		return NULL;
 	}
 	res->len = 0;
+	res->cap = cap;
 	return res;
 }
 
 /*
-Pushes a new variable `name` and its value `val` onto the 
-variable map. This operation returns NULL if it fails.
+Returns the position of the variable with interned name `id` in 
+`vm`, or -1 if `vm` doesn't contain it.
 */
-varmap* push_to_varmap(varmap* vm, char* name, long double val) {
-	
-	//printf("pushing val: %Lf...\n", val);
-	
-	varmap* tmp = (varmap*)realloc(vm, sizeof(varmap) + sizeof(vardef) * (vm->len + 1));
-	if (!tmp) {
-		puts("error: insufficient heap memory for new varmap");
-		return vm;
+long varmap_find(varmap* vm, size_t id) {
+	size_t at = __varmap_index(vm)[__varmap_probe(vm, id)];
+	return at ? (long)at - 1 : -1;
+}
+
+/*
+Pushes a new variable, named by its interned id, and its value 
+`val` onto the variable map. The map doubles its capacity when 
+full, which may move it, so the returned pointer replaces `vm`; 
+on failure `vm` is returned unchanged.
+*/
+varmap* push_id_to_varmap(varmap* vm, size_t id, scalar val) {
+	if (vm->len == vm->cap) {
+		varmap* tmp = (varmap*)realloc(vm, __varmap_bytes(2 * vm->cap));
+		if (!tmp) {
+			puts("error: insufficient heap memory for new varmap");
+			return vm;
+		}
+		vm = tmp;
+		vm->cap *= 2;
+		__reindex_varmap(vm);
 	}
-	vm = tmp;
-	vm->vars[vm->len] = (vardef){ name, val };
+
+	vm->vars[vm->len] = (vardef){ interned_name(id), val, id };
+	size_t slot = __varmap_probe(vm, id);
+	if (!__varmap_index(vm)[slot])
+		__varmap_index(vm)[slot] = vm->len + 1;
 	vm->len++;
 	return vm;
 }
 
+/*
+Pushes a new variable `name` and its value `val` onto the 
+variable map, as `push_id_to_varmap`. The variable's name is 
+interned, so it stays valid after `name` itself is freed.
+*/
+varmap* push_to_varmap(varmap* vm, char* name, scalar val) {
+	size_t id = intern(name);
+	if (id == SIZE_MAX)
+		return vm;
+	return push_id_to_varmap(vm, id, val);
+}
+
 /*
 Prints a varmap's key-value pairs to stdout.
 */
 void print_varmap(varmap* vm) {
 	puts("{");
 	for (int i = 0; i < vm->len-1; i++)
-		printf("  %s : %Lf,\n", vm->vars[i].name, vm->vars[i].val);
-	printf("  %s : %Lf\n", vm->vars[vm->len-1].name, vm->vars[vm->len-1].val);
+		printf("  %s : " SCALAR_FMT ",\n", vm->vars[i].name, vm->vars[i].val);
+	printf("  %s : " SCALAR_FMT "\n", vm->vars[vm->len-1].name, vm->vars[vm->len-1].val);
 	puts("}");
 }
 
+/*
+Returns a copy of `vm`, released by one `free` like any other 
+varmap. Its names are interned, so the copy stays valid after the 
+equations they came from are destroyed.
+*/
+varmap* copy_varmap(varmap* vm) {
+	varmap* res = (varmap*)malloc(__varmap_bytes(vm->cap));
+	if (!res) {
+		puts("error: insufficient heap memory for varmap copy");
+		return NULL;
+	}
+	memcpy(res, vm, __varmap_bytes(vm->cap));
+	return res;
+}
+
 /*
 Rearranges an equation algebraically to an expression form 
 that should evaluate to 0 when solved. For example, `x = -3`
@@ -77,10 +170,6 @@ would become `x - (-3)`, which would evaluate to 0 when
 `x` = -3.
 */
 char* functionify(char* equation) {
-	
-	DoublyLinkedList* res = new_doubly_linked_list();
-	if (!res)
-		return NULL;
 
 	if (instances(equation, "=") != 1) {
 		puts("error: equation must contain exactly one `=` char");
@@ -88,20 +177,16 @@ char* functionify(char* equation) {
 		return NULL;
 	}
 
-	// setup for strtok_s...
-	char* ctx = NULL;
-	char delim[] = "=";
-
-	// gather the lhs, rhs...
-	char* token = strtok_s(equation, delim, &ctx);
-	char* lhs = token;
-	token = strtok_s(NULL, delim, &ctx);
-	char* rhs = token;
+	// gather the lhs, rhs either side of the `=`...
+	char* eq = strchr(equation, '=');
+	char* lhs = equation;
+	char* rhs = eq + 1;
+	size_t lhslen = eq - equation;
 
 	// malloc a new char* for the lhs, rhs, & extra chars...
 	// `%s-(%s)\0`
 	//    12  34
-	size_t totlen = (long long)strlen(lhs) + (long long)strlen(rhs) + (size_t)4;
+	size_t totlen = lhslen + strlen(rhs) + (size_t)4;
 	char* expr = (char*)malloc(sizeof(char) * totlen);
 	if (!expr) {
 		puts("error: insufficient heap memory for rearranged expression");
@@ -110,7 +195,7 @@ char* functionify(char* equation) {
 
 	expr[totlen - 1] = '\0';
 	char* restmp = expr;
-	for (char* tmp = lhs; *tmp; tmp++) {
+	for (char* tmp = lhs; tmp < eq; tmp++) {
 		*restmp = *tmp;
 		restmp++;
 	}
@@ -130,119 +215,152 @@ char* functionify(char* equation) {
 }
 
 /*
-Returns a DoublyLinkedList of variables in the given 
-postfix-formatted DoublyLinkedList. For example, 
+Returns a boolean statement specifying whether a 
+variable `pat` exists in a varmap `vm`.
+*/
+bool varmap_contains(varmap* vm, char* pat) {
+	size_t id = find_interned(pat);
+	return id != SIZE_MAX && varmap_find(vm, id) >= 0;
+}
+
+/*
+Returns a varmap of the variables in the given postfix 
+tokens, each set to 1. For example, 
 vars(`x` <=> `y` <=> `3` <=> `-` <=> `-`) would return
-`x` <=> `y`.
+`x` <=> `y`. Returns NULL if memory runs out.
 */
-varmap* vars(DoublyLinkedList* d) {
+varmap* vars(vector* d) {
 
 	varmap* vm = new_varmap();
+	if (!vm)
+		return NULL;
 
-	for (snode* tmp = d->head; tmp; tmp = tmp->next) {
-	
-		long double decimal = strtold(tmp->data, NULL);
-		if (!decimal) {
-			bool is_zero = true; // assume '0.000...' until proven to be a variable
-			if (!strcmp_g_batch(tmp->data, functions) && !strcmp_g_batch(tmp->data, operators)) {
-				for (char* strtmp = tmp->data; *strtmp; strtmp++)
-					if (*strtmp != '0' && *strtmp != '.')
-						is_zero = false; // string is not '0.000...' if it contains anything other than '0' or '.'
-			}
-
-			// push a new variable set to 1 to the varmap
-			if (!is_zero)
-				vm = push_to_varmap(vm, tmp->data, 1);
+	// push a new variable set to 1 to the varmap, once per name
+	for (size_t i = 0; i < d->len; i++) {
+		token* tok = &vector_item(d, token, i);
+		if (tok->kind != TOKEN_IDENT || varmap_find(vm, tok->name) >= 0)
+			continue;
+		size_t len = vm->len;
+		vm = push_id_to_varmap(vm, tok->name, 1);
+		if (vm->len == len) {
+			free(vm);
+			return NULL;
 		}
 	}
-	//init_varmap(vm);
 
 	return vm;
 }
 
 /*
-Returns a boolean statement specifying whether a 
-variable `pat` exists in a varmap `vm`.
+Returns the scalar value of a string-represented
+variable in the given varmap `vm`.
 */
-bool varmap_contains(varmap* vm, char* pat) {
+scalar index_varmap(varmap* vm, char* key) {
+	size_t id = find_interned(key);
+	long i = id == SIZE_MAX ? -1 : varmap_find(vm, id);
+	return i < 0 ? 0 : vm->vars[i].val;
+}
 
-	for (int i = 0; i < vm->len; i++) {
-		//printf("checking index %d of varmap for variable '%s'...\n", i, pat);
-		if (strcmp(vm->vars[i].name, pat) == 0)
-			return true;
-	}
-	return false;
+/*
+Returns the index of variable `name` in the varmap `vm`, or -1 if 
+`vm` doesn't contain it.
+*/
+long __varmap_slot(void* vm, char* name) {
+	size_t id = find_interned(name);
+	return id == SIZE_MAX ? -1 : varmap_find((varmap*)vm, id);
 }
 
 /*
-Returns the long double value of a string-represented
-variable in the given varmap `vm`.
+`varmap_find` on a varmap passed as a `void*`, so it can be used 
+as a `slot_lookup`.
 */
-long double index_varmap(varmap* vm, char* key) {
-	for (int i = 0; i < vm->len; i++) {
-		if (strcmp(vm->vars[i].name, key) == 0) {
-			return vm->vars[i].val;
-		}
-	}
-	return 0;
+long __varmap_id_slot(void* vm, size_t id) {
+	return varmap_find((varmap*)vm, id);
 }
 
 /*
-Returns the error in an equation for a given attempted solution
+Compiles a postfix expression so that its variables are bound, by 
+index, to the variables of `vm`. The program can then be evaluated 
+against `vm` (or any varmap with the same variables in the same 
+order) by `eval_with_varmap` as many times as needed, with no 
+string handling per evaluation. Returns NULL if the expression 
+uses a variable `vm` doesn't have.
 */
-long double __remaining_soln_error(DoublyLinkedList* postfix, varmap* vars) {
-	DoublyLinkedList* pfcpy = copy_doubly_linked_list(postfix);
-	for (snode* tmp = pfcpy->head; tmp; tmp = tmp->next) {
-		if (varmap_contains(vars, tmp->data)) {
-			char decimal[50];
-			long double val = index_varmap(vars, tmp->data);	// get the decimal value
-			snprintf(decimal, 50, "%Lf", val);					// put a string version of the decimal in `decimal`
-
-			//puts("pluggin' and chuggin'. Here's ur proof in the pudding...");
-			//print_doubly_linked_list(pfcpy);
-			tmp->data = decimal;								// assign long double string to node `tmp`
-			//print_doubly_linked_list(pfcpy);
-			//puts("");
-		}	
-	}
-	//print_doubly_linked_list(pfcpy);
-	return postfix_evaluator(pfcpy); // this destroys pfcpy, but not the postfix passed to the function
+program* compile_with_varmap(vector* postfix, varmap* vm) {
+	return compile_postfix_bound(postfix, __varmap_id_slot, vm, vm->len);
+}
+
+/*
+Evaluates a program compiled by `compile_with_varmap`, reading 
+each variable's value directly out of `vm`.
+*/
+scalar eval_with_varmap(program* prog, varmap* vm) {
+	return run_program_strided(prog, &vm->vars[0].val, sizeof(vardef));
+}
+
+/*
+Returns the error in an equation for a given attempted solution. 
+This compiles the equation on every call; loops that evaluate the 
+same equation repeatedly should use `compile_with_varmap` once and 
+`eval_with_varmap` on every iteration instead.
+*/
+scalar __remaining_soln_error(vector* postfix, varmap* vars) {
+	program* prog = compile_with_varmap(postfix, vars);
+	if (!prog)
+		return (scalar)NAN;
+
+	scalar res = eval_with_varmap(prog, vars);
+	destroy_program(prog);
+	return res;
+}
+
+/*
+Returns the exact derivative of a compiled equation w.r.t. the 
+variable at index `wrt` of `vars`, using forward-mode automatic 
+differentiation.
+*/
+scalar ddx_with_varmap(program* prog, varmap* vars, size_t wrt) {
+	scalar deriv;
+	run_program_dual(prog, &vars->vars[0].val, sizeof(vardef), wrt, &deriv);
+	return deriv;
+}
+
+/*
+Writes the exact partial derivative of a compiled equation w.r.t. 
+every variable of `vars` to `grad` (which must hold `vars->len` 
+values) using reverse-mode automatic differentiation, and returns 
+the equation's value. This is one Jacobian row for the price of 
+about two evaluations.
+*/
+scalar gradient_with_varmap(program* prog, varmap* vars, scalar* grad) {
+	return run_program_gradient(prog, &vars->vars[0].val, sizeof(vardef), grad);
 }
 
 /*
 Returns the derivative of an expression w.r.t. the variable `wrt`
 */
-long double ddx(DoublyLinkedList* postfix, varmap* vars, char* wrt) {
-	
-	const long double dx = 1e-3;
-	varmap* dvars = new_varmap();
-	if (!dvars)
-		return 0;
-
-	for (int i = 0; i < vars->len; i++) {
-		if (strcmp(vars->vars[i].name, wrt) == 0) {
-			//printf("detected %s as wrt.\n", wrt);
-			dvars = push_to_varmap(dvars, vars->vars[i].name, vars->vars[i].val + dx);	// push changed variable
-		} else
-			dvars = push_to_varmap(dvars, vars->vars[i].name, vars->vars[i].val);		// push normal value 
-	}
+scalar ddx(vector* postfix, varmap* vars, char* wrt) {
 
-	//print_varmap(dvars);
-	long double dres = __remaining_soln_error(postfix, dvars),
-		res = __remaining_soln_error(postfix, vars);
+	long slot = __varmap_slot(vars, wrt);
+	if (slot < 0)
+		return 0; // expression can't depend on a variable it doesn't have
 
+	program* prog = compile_with_varmap(postfix, vars);
+	if (!prog)
+		return (scalar)NAN;
 
-	//printf("wrt %s:ddx = %Lf\n\n", wrt, (dres - res)/dx); 
-	return ((dres - res) / dx);
+	scalar res = ddx_with_varmap(prog, vars, (size_t)slot);
+	destroy_program(prog);
+	return res;
 }
 
 typedef struct {
 	size_t len;
-	DoublyLinkedList* eqns[];
+	vector* eqns[];
 } SystemOfEquations;
 
 SystemOfEquations* new_system(void) {
-	SystemOfEquations* res = (SystemOfEquations*)malloc(sizeof(SystemOfEquations) + sizeof(DoublyLinkedList*));
+	SystemOfEquations* res = (SystemOfEquations*)malloc(sizeof(SystemOfEquations) + sizeof(vector*));
 	if (!res) {
 		puts("error: insufficient heap memory for new system of equations");
 		return NULL;
@@ -252,19 +370,19 @@ SystemOfEquations* new_system(void) {
 	return res;
 }
 
-SystemOfEquations* push_to_system_vector(SystemOfEquations* s, DoublyLinkedList* d) {
+SystemOfEquations* push_to_system_vector(SystemOfEquations* s, vector* d) {
 	if (!s) {
 		puts("error: given system of equations pointer is NULL");
 		return s;
 	}
 
 	size_t	newlen = s->len + 1,
-			newsize = sizeof(SystemOfEquations) + (newlen * sizeof(DoublyLinkedList*));
+			newsize = sizeof(SystemOfEquations) + (newlen * sizeof(vector*));
 	SystemOfEquations* tmp = (SystemOfEquations*)realloc(s, newsize);
 
 	if (!tmp) {
 		puts("error: insufficient heap memory for new equation in system");
-		printf("equation postfix: "); print_doubly_linked_list(d);
+		printf("equation postfix: "); print_tokens(d);
 		return s;
 	}
 	s = tmp;
@@ -274,10 +392,18 @@ SystemOfEquations* push_to_system_vector(SystemOfEquations* s, DoublyLinkedList*
 	return s;
 }
 
+void destroy_system(SystemOfEquations* s) {
+	if (!s)
+		return;
+	for (size_t i = 0; i < s->len; i++)
+		destroy_vector(s->eqns[i]);
+	free(s);
+}
+
 void print_system_of_equations(SystemOfEquations* s) {
 	puts("{");
-	for (DoublyLinkedList* tmp = s->eqns; tmp < s->len; tmp++)
-		print_doubly_linked_list(tmp);
+	for (size_t i = 0; i < s->len; i++)
+		print_tokens(s->eqns[i]);
 	puts("}");
 }
 
@@ -287,63 +413,74 @@ matrix* jacobian(DoublyLinkedList* sys) {
 	if (!rpn_soe)
 		return NULL;
 	for (snode* tmp = sys->head; tmp; tmp = tmp->next) {
-		DoublyLinkedList* pf = shunting_yard(words(functionify(tmp->data)));
-		rpn_soe = push_to_system_vector(rpn_soe, pf);
+		// words() copies out of the string it's given
+		char* fn = functionify(tmp->data);
+		vector* pf = fn ? shunting_yard(words(fn)) : NULL;
+		free(fn);
+		size_t len = rpn_soe->len;
+		if (pf)
+			rpn_soe = push_to_system_vector(rpn_soe, pf);
+		if (rpn_soe->len == len) {
+			destroy_vector(pf);
+			destroy_system(rpn_soe);
+			return NULL;
+		}
 	}
 
 	//puts("established system vector correctly");
 
-	varmap* ivars = vars(rpn_soe->eqns[0]);
-	//puts("ivars:");
-	//print_varmap(ivars);
-
-	if (ivars->len != rpn_soe->len) {
-		puts("error: system of equations is improperly constrained. (independent variable issue)");
-		printf("DOF: %zu; EQS: %zu\n", ivars->len, rpn_soe->len);
-		return NULL;
-	}
-
-	//puts("established ivars correctly");
+	matrix* jacobian = NULL;
 
-	for (int i = 1; i < rpn_soe->len; i++) {
-		//printf("equation index: %d\n", i);
+	// the unknowns are every variable that appears in any equation;
+	// an equation may use only some of them
+	varmap* ivars = new_varmap();
+	if (!ivars)
+		goto cleanup;
+	for (int i = 0; i < rpn_soe->len; i++) {
 		varmap* tmpvars = vars(rpn_soe->eqns[i]);
-		//puts("tmpvars:");
-		//print_varmap(tmpvars);
-
-		//printf("len of tmpvars = %zu\n", tmpvars->len);
-		if (tmpvars->len != rpn_soe->len) {
-			puts("error: system of equations is improperly constrained. (equation variables mismatch)");
-			printf("DOF: %zu; EQS: %zu\n", tmpvars->len, rpn_soe->len);
-			return NULL;
-		}
+		if (!tmpvars)
+			goto cleanup;
 		for (int j = 0; j < tmpvars->len; j++) {
-			if (!varmap_contains(ivars, tmpvars->vars[j].name)) {
-				puts("error: found extra variable in system");
-				return NULL;
+			if (varmap_find(ivars, tmpvars->vars[j].id) >= 0)
+				continue;
+			size_t len = ivars->len;
+			ivars = push_id_to_varmap(ivars, tmpvars->vars[j].id, 1);
+			if (ivars->len == len) {
+				free_s(tmpvars);
+				goto cleanup;
 			}
 		}
 		free_s(tmpvars);
-		tmpvars = NULL;
+	}
+
+	if (ivars->len != rpn_soe->len) {
+		puts("error: system of equations is improperly constrained. (independent variable issue)");
+		printf("DOF: %zu; EQS: %zu\n", ivars->len, rpn_soe->len);
+		goto cleanup;
 	}
 
 	//puts("checked constraints... no issues");
 
 	// if function reaches this point, system should be NxN
-	matrix* jacobian = new_nxn(rpn_soe->len);
-	for (int i = 0; i < rpn_soe->len; i++) {
-		for (int j = 0; j < ivars->len; j++) {
-			//printf("evaluating ddx for eqn %d w.r.t. %s...\n", i, ivars->vars[j].name);
-			//printf("equation is: "); print_doubly_linked_list(rpn_soe->eqns[i]);
-			jacobian->data[i]->data[j] = ddx(
-				rpn_soe->eqns[i], 
-				ivars,
-				ivars->vars[j].name
-			);
+	jacobian = new_nxn(rpn_soe->len);
+	for (int i = 0; jacobian && i < rpn_soe->len; i++) {
+
+		// compile each equation once
+		program* prog = compile_with_varmap(rpn_soe->eqns[i], ivars);
+		if (!prog) {
+			destroy_matrix(jacobian);
+			jacobian = NULL;
+			goto cleanup;
 		}
+		// one reverse sweep yields the whole row of partials
+		gradient_with_varmap(prog, ivars, &mac(jacobian, i, 0));
+		destroy_program(prog);
 	}
 
 	//puts("created matrix successfully");
 
+cleanup:
+	free(ivars);
+	destroy_system(rpn_soe);
 	return jacobian;
 }
\ No newline at end of file
@@ -1,47 +1,71 @@
 #pragma once
 #include <stdlib.h>
 #include <stdbool.h>
+#include "precision.h"
 #include "clinalg.h"
 #include "dlinklist.h"
+#include "bytecode.h"
 
 #define free_s(x) free(x); x = NULL
 
 typedef struct {
 	char* name;
-	long double val;
+	scalar val;
+	size_t id;
 } vardef;
 
 typedef struct {
 	size_t len;
+	size_t cap;
 	vardef vars[];
 } varmap;
 
 varmap* new_varmap(void);
 
-varmap* push_to_varmap(varmap* vm, char* name, long double val);
+long varmap_find(varmap* vm, size_t id);
+
+varmap* push_id_to_varmap(varmap* vm, size_t id, scalar val);
+
+varmap* push_to_varmap(varmap* vm, char* name, scalar val);
 
 void print_varmap(varmap* vm);
 
+varmap* copy_varmap(varmap* vm);
+
 typedef struct {
 	size_t len;
-	DoublyLinkedList* eqns[];
+	vector* eqns[];
 } SystemOfEquations;
 
 char* functionify(char* equation);
 
-varmap* vars(DoublyLinkedList* d);
+varmap* vars(vector* d);
 
 bool varmap_contains(varmap* vm, char* pat);
 
-long double index_varmap(varmap* vm, char* key);
+scalar index_varmap(varmap* vm, char* key);
+
+long __varmap_slot(void* vm, char* name);
+
+long __varmap_id_slot(void* vm, size_t id);
 
-long double __remaining_soln_error(DoublyLinkedList* postfix, varmap* vars);
+program* compile_with_varmap(vector* postfix, varmap* vm);
 
-long double ddx(DoublyLinkedList* postfix, varmap* vars, char* wrt);
+scalar eval_with_varmap(program* prog, varmap* vm);
+
+scalar __remaining_soln_error(vector* postfix, varmap* vars);
+
+scalar ddx_with_varmap(program* prog, varmap* vars, size_t wrt);
+
+scalar gradient_with_varmap(program* prog, varmap* vars, scalar* grad);
+
+scalar ddx(vector* postfix, varmap* vars, char* wrt);
 
 SystemOfEquations* new_system(void);
 
-void push_to_system_vector(SystemOfEquations* s, DoublyLinkedList* d);
+void push_to_system_vector(SystemOfEquations* s, vector* d);
+
+void destroy_system(SystemOfEquations* s);
 
 void print_system_of_equations(SystemOfEquations* s);
 
@@ -0,0 +1,669 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "precision.h"
+#include "bytecode.h"
+
+/*
+A node of an expression tree. Leaves are constants (`value`) and 
+variables (`slot`, the environment slot of the variable); inner 
+nodes apply the operator or function `op` (an `opcode`) to `lhs`, 
+and to `rhs` for binary operators. `id` is the node's index in the 
+pool that owns it. Nodes are only ever created after their 
+children, so ids are a topological order.
+*/
+struct __expr {
+	unsigned op;
+	unsigned slot;
+	scalar value;
+	struct __expr* lhs;
+	struct __expr* rhs;
+	size_t id;
+};
+
+typedef struct __expr expr;
+
+/*
+Owns every node of a set of expressions. Nodes are hash-consed: 
+`index` is an open-addressing table of `icap` slots (holding node 
+id + 1, 0 for empty) over every node's contents, and asking for a 
+node identical to an existing one (same operator and operands, or 
+the same constant or variable) returns the existing node. So 
+expressions are DAGs in which equal subexpressions are one node, 
+and differentiation shares subexpressions freely between the 
+input and its derivatives. Nodes are never freed one by one, only 
+all at once with the pool.
+*/
+typedef struct {
+	size_t len;
+	size_t cap;
+	expr** nodes;
+	size_t icap;
+	size_t* index;
+} expr_pool;
+
+expr_pool* new_expr_pool(void) {
+	expr_pool* pool = (expr_pool*)calloc(1, sizeof(expr_pool));
+	if (pool == NULL)
+		puts("error: insufficient heap memory for new expression pool");
+	return pool;
+}
+
+void destroy_expr_pool(expr_pool* pool) {
+	for (size_t i = 0; i < pool->len; i++)
+		free(pool->nodes[i]);
+	free(pool->nodes);
+	free(pool->index);
+	free(pool);
+	pool = NULL;
+}
+
+size_t __expr_hash(unsigned op, unsigned slot, scalar value, expr* lhs, expr* rhs) {
+	double d = (double)value;
+	uint64_t bits;
+	memcpy(&bits, &d, sizeof(bits));
+
+	uint64_t h = op;
+	h = (h ^ slot) * 0x9E3779B97F4A7C15ULL;
+	h = (h ^ bits) * 0x9E3779B97F4A7C15ULL;
+	h = (h ^ (lhs ? lhs->id + 1 : 0)) * 0x9E3779B97F4A7C15ULL;
+	h = (h ^ (rhs ? rhs->id + 1 : 0)) * 0x9E3779B97F4A7C15ULL;
+	return (size_t)(h ^ (h >> 29));
+}
+
+bool __expr_equal(expr* e, unsigned op, unsigned slot, scalar value, expr* lhs, expr* rhs) {
+	return e->op == op && e->slot == slot && e->lhs == lhs && e->rhs == rhs
+		&& e->value == value && signbit(e->value) == signbit(value);
+}
+
+/*
+Returns the index slot holding the node equal to the given one, or 
+the empty slot where it would go.
+*/
+size_t __expr_probe(expr_pool* pool, size_t h, unsigned op, unsigned slot, scalar value, expr* lhs, expr* rhs) {
+	size_t mask = pool->icap - 1;
+	size_t i = h & mask;
+	while (pool->index[i] && !__expr_equal(pool->nodes[pool->index[i] - 1], op, slot, value, lhs, rhs))
+		i = (i + 1) & mask;
+	return i;
+}
+
+/*
+Doubles the pool's hash index and rehashes every node into it.
+*/
+bool __grow_expr_index(expr_pool* pool) {
+	size_t icap = pool->icap ? 2 * pool->icap : 128;
+	size_t* index = (size_t*)calloc(icap, sizeof(size_t));
+	if (index == NULL)
+		return false;
+	free(pool->index);
+	pool->index = index;
+	pool->icap = icap;
+
+	for (size_t id = 0; id < pool->len; id++) {
+		expr* e = pool->nodes[id];
+		size_t h = __expr_hash(e->op, e->slot, e->value, e->lhs, e->rhs);
+		index[__expr_probe(pool, h, e->op, e->slot, e->value, e->lhs, e->rhs)] = id + 1;
+	}
+	return true;
+}
+
+expr* __new_expr(expr_pool* pool, unsigned op, unsigned slot, scalar value, expr* lhs, expr* rhs) {
+	if (2 * (pool->len + 1) > pool->icap && !__grow_expr_index(pool)) {
+		puts("error: insufficient heap memory for new expression node");
+		return NULL;
+	}
+	size_t h = __expr_hash(op, slot, value, lhs, rhs);
+	size_t at = __expr_probe(pool, h, op, slot, value, lhs, rhs);
+	if (pool->index[at])
+		return pool->nodes[pool->index[at] - 1];
+
+	if (pool->len == pool->cap) {
+		size_t cap = pool->cap ? pool->cap * 2 : 64;
+		expr** tmp = (expr**)realloc(pool->nodes, sizeof(expr*) * cap);
+		if (tmp == NULL) {
+			puts("error: insufficient heap memory for new expression node");
+			return NULL;
+		}
+		pool->nodes = tmp;
+		pool->cap = cap;
+	}
+
+	expr* e = (expr*)malloc(sizeof(expr));
+	if (e == NULL) {
+		puts("error: insufficient heap memory for new expression node");
+		return NULL;
+	}
+	*e = (expr){ op, slot, value, lhs, rhs, pool->len };
+	pool->nodes[pool->len++] = e;
+	pool->index[at] = pool->len;
+	return e;
+}
+
+expr* expr_const(expr_pool* pool, scalar value) {
+	return __new_expr(pool, OP_CONST, 0, value, NULL, NULL);
+}
+
+expr* expr_var(expr_pool* pool, unsigned slot) {
+	return __new_expr(pool, OP_VAR, slot, 0, NULL, NULL);
+}
+
+bool __is_const(expr* e, scalar value) {
+	return e->op == OP_CONST && e->value == value;
+}
+
+/*
+Creates the node `lhs op rhs` (or `op(lhs)` for a function), 
+simplifying as it goes: operations on constants are folded, and 
+identities such as `x + 0`, `x * 1`, `x * 0`, `x ^ 1` and `x - x` 
+collapse. Constant factors are kept on the left of a product and 
+merged with the constant factor of a product on the right.
+*/
+expr* expr_node(expr_pool* pool, unsigned op, expr* lhs, expr* rhs) {
+	if (lhs == NULL || (op <= OP_POW && rhs == NULL))
+		return NULL;
+
+	bool binary = op <= OP_POW;
+	if (lhs->op == OP_CONST && (!binary || rhs->op == OP_CONST))
+		return expr_const(pool, apply_opcode(op, lhs->value, binary ? rhs->value : 0));
+
+	switch (op) {
+	case OP_ADD:
+		if (__is_const(lhs, 0))
+			return rhs;
+		if (__is_const(rhs, 0))
+			return lhs;
+		break;
+	case OP_SUB:
+		if (__is_const(rhs, 0))
+			return lhs;
+		if (lhs == rhs)
+			return expr_const(pool, 0);
+		break;
+	case OP_MUL:
+		if (__is_const(lhs, 0) || __is_const(rhs, 0))
+			return expr_const(pool, 0);
+		if (__is_const(lhs, 1))
+			return rhs;
+		if (__is_const(rhs, 1))
+			return lhs;
+		if (rhs->op == OP_CONST) {
+			expr* tmp = lhs;
+			lhs = rhs;
+			rhs = tmp;
+		}
+		if (lhs->op == OP_CONST && rhs->op == OP_MUL && rhs->lhs->op == OP_CONST)
+			return expr_node(pool, OP_MUL, expr_const(pool, lhs->value * rhs->lhs->value), rhs->rhs);
+		break;
+	case OP_DIV:
+		if (__is_const(lhs, 0))
+			return expr_const(pool, 0);
+		if (__is_const(rhs, 1))
+			return lhs;
+		if (lhs == rhs)
+			return expr_const(pool, 1);
+		break;
+	case OP_POW:
+		if (__is_const(rhs, 0) || __is_const(lhs, 1))
+			return expr_const(pool, 1);
+		if (__is_const(rhs, 1))
+			return lhs;
+		break;
+	}
+	return __new_expr(pool, op, 0, 0, lhs, binary ? rhs : NULL);
+}
+
+/*
+Rebuilds the expression tree of a compiled program, simplifying 
+constant subexpressions on the way.
+*/
+expr* expr_from_program(expr_pool* pool, program* prog) {
+	expr** stack = (expr**)malloc(sizeof(expr*) * (prog->depth + 1));
+	if (stack == NULL) {
+		puts("error: insufficient heap memory for expression stack");
+		return NULL;
+	}
+
+	size_t top = 0;
+	for (size_t pc = 0; pc < prog->len; pc++) {
+		instruction ins = prog->code[pc];
+		if (ins.op == OP_CONST)
+			stack[top++] = expr_const(pool, prog->consts[ins.arg]);
+		else if (ins.op == OP_VAR)
+			stack[top++] = expr_var(pool, ins.arg);
+		else if (ins.op <= OP_POW) {
+			top--;
+			stack[top - 1] = expr_node(pool, ins.op, stack[top - 1], stack[top]);
+		}
+		else
+			stack[top - 1] = expr_node(pool, ins.op, stack[top - 1], NULL);
+	}
+
+	expr* res = stack[0];
+	free(stack);
+	return res;
+}
+
+expr* __differentiate(expr_pool* pool, expr* e, unsigned wrt, expr** memo) {
+	if (e == NULL)
+		return NULL;
+	if (memo[e->id])
+		return memo[e->id];
+
+	expr* u = e->lhs;
+	expr* v = e->rhs;
+	expr* du = u ? __differentiate(pool, u, wrt, memo) : NULL;
+	expr* dv = v ? __differentiate(pool, v, wrt, memo) : NULL;
+	expr* res = NULL;
+
+	#define C(x) expr_const(pool, (x))
+	#define N(op, a, b) expr_node(pool, (op), (a), (b))
+
+	switch (e->op) {
+	case OP_CONST:	res = C(0);	break;
+	case OP_VAR:	res = C(e->slot == wrt ? 1 : 0);	break;
+	case OP_ADD:	res = N(OP_ADD, du, dv);	break;
+	case OP_SUB:	res = N(OP_SUB, du, dv);	break;
+	case OP_MUL:	res = N(OP_ADD, N(OP_MUL, du, v), N(OP_MUL, u, dv));	break;
+	case OP_DIV:
+		if (__is_const(dv, 0))
+			res = N(OP_DIV, du, v);
+		else
+			res = N(OP_DIV, N(OP_SUB, N(OP_MUL, du, v), N(OP_MUL, u, dv)), N(OP_POW, v, C(2)));
+		break;
+	case OP_POW:
+		if (__is_const(dv, 0))		// u^c -> c u^(c-1) u'
+			res = N(OP_MUL, N(OP_MUL, v, N(OP_POW, u, N(OP_SUB, v, C(1)))), du);
+		else if (__is_const(du, 0))	// c^v -> c^v ln(c) v'
+			res = N(OP_MUL, N(OP_MUL, e, N(OP_LN, u, NULL)), dv);
+		else						// u^v (v' ln u + v u' / u)
+			res = N(OP_MUL, e, N(OP_ADD,
+				N(OP_MUL, dv, N(OP_LN, u, NULL)),
+				N(OP_DIV, N(OP_MUL, v, du), u)
+			));
+		break;
+	case OP_SIN:	res = N(OP_MUL, N(OP_COS, u, NULL), du);	break;
+	case OP_COS:	res = N(OP_MUL, C(-1), N(OP_MUL, N(OP_SIN, u, NULL), du));	break;
+	case OP_TAN:	res = N(OP_DIV, du, N(OP_POW, N(OP_COS, u, NULL), C(2)));	break;
+	case OP_ASIN:	res = N(OP_DIV, du, N(OP_SQRT, N(OP_SUB, C(1), N(OP_POW, u, C(2))), NULL));	break;
+	case OP_ACOS:	res = N(OP_MUL, C(-1), N(OP_DIV, du, N(OP_SQRT, N(OP_SUB, C(1), N(OP_POW, u, C(2))), NULL)));	break;
+	case OP_ATAN:	res = N(OP_DIV, du, N(OP_ADD, C(1), N(OP_POW, u, C(2))));	break;
+	case OP_LOG10:	res = N(OP_DIV, du, N(OP_MUL, N(OP_LN, C(10), NULL), u));	break;
+	case OP_LN:		res = N(OP_DIV, du, u);	break;
+	case OP_SQRT:	res = N(OP_DIV, du, N(OP_MUL, C(2), e));	break;
+	case OP_EXP:	res = N(OP_MUL, e, du);	break;
+	}
+
+	#undef C
+	#undef N
+
+	memo[e->id] = res;
+	return res;
+}
+
+/*
+Returns the simplified symbolic derivative of `e` w.r.t. the 
+variable in environment slot `wrt`. The result shares subtrees 
+with `e`, and each node of `e` is differentiated only once.
+*/
+expr* differentiate(expr_pool* pool, expr* e, unsigned wrt) {
+	expr** memo = (expr**)calloc(pool->len, sizeof(expr*));
+	if (memo == NULL) {
+		puts("error: insufficient heap memory for differentiation");
+		return NULL;
+	}
+	expr* res = __differentiate(pool, e, wrt, memo);
+	free(memo);
+	return res;
+}
+
+extern const char* __op_names[];
+
+/*
+Prints an expression in fully parenthesized infix notation.
+*/
+void __print_expr(expr* e, char** names) {
+	if (e->op == OP_CONST)
+		printf(SCALAR_FMT, e->value);
+	else if (e->op == OP_VAR)
+		printf("%s", names && names[e->slot] ? names[e->slot] : "?");
+	else if (e->op <= OP_POW) {
+		printf("(");
+		__print_expr(e->lhs, names);
+		printf(" %s ", __op_names[e->op - OP_ADD]);
+		__print_expr(e->rhs, names);
+		printf(")");
+	}
+	else {
+		printf("%s(", __op_names[e->op - OP_ADD]);
+		__print_expr(e->lhs, names);
+		printf(")");
+	}
+}
+
+void print_expr(expr* e, char** names) {
+	__print_expr(e, names);
+	printf("\n");
+}
+
+/*
+Returns the number of instructions it takes to evaluate `e`, 
+counting shared subtrees once per use.
+*/
+size_t __expr_size(expr* e) {
+	if (e->lhs == NULL)
+		return 1;
+	return 1 + __expr_size(e->lhs) + (e->rhs ? __expr_size(e->rhs) : 0);
+}
+
+void __emit_expr(program* prog, expr* e, size_t* pc, size_t* depth) {
+	if (e->op == OP_CONST) {
+		size_t slot = 0;
+		while (slot < prog->nconsts && prog->consts[slot] != e->value)
+			slot++;
+		if (slot == prog->nconsts)
+			prog->consts[prog->nconsts++] = e->value;
+		prog->code[(*pc)++] = (instruction){ OP_CONST, (unsigned)slot };
+		(*depth)++;
+	}
+	else if (e->op == OP_VAR) {
+		prog->code[(*pc)++] = (instruction){ OP_VAR, e->slot };
+		(*depth)++;
+	}
+	else {
+		__emit_expr(prog, e->lhs, pc, depth);
+		if (e->rhs) {
+			__emit_expr(prog, e->rhs, pc, depth);
+			(*depth)--;
+		}
+		prog->code[(*pc)++] = (instruction){ e->op, 0 };
+	}
+	if (*depth > prog->depth)
+		prog->depth = *depth;
+}
+
+/*
+Compiles an expression tree back into a program. Variable slots 
+keep their meaning from `like`, the program the tree came from, 
+so the result evaluates against the same environment. Returns 
+NULL if the expression is too deep for `PROGRAM_STACK_MAX`.
+*/
+program* compile_expr(expr* e, program* like) {
+	if (e == NULL)
+		return NULL;
+
+	size_t len = __expr_size(e);
+	program* prog = __new_program(len, like->nvars > len ? like->nvars : len);
+	if (prog == NULL)
+		return NULL;
+	prog->nvars = like->nvars;
+	for (size_t i = 0; i < like->nvars; i++)
+		prog->names[i] = like->names[i];
+
+	size_t pc = 0, depth = 0;
+	__emit_expr(prog, e, &pc, &depth);
+
+	if (prog->depth > PROGRAM_STACK_MAX) {
+		printf("error: expression needs a stack of %zu values, more than %d. aborting compilation...\n",
+			prog->depth, PROGRAM_STACK_MAX);
+		destroy_program(prog);
+		return NULL;
+	}
+	return prog;
+}
+
+/*
+One step of an `expr_dag`: `vals[dst] = op(vals[a], vals[b])` (`b` 
+unused for functions), or for OP_VAR, `vals[dst]` = the value in 
+environment slot `a`.
+*/
+typedef struct {
+	unsigned op;
+	unsigned dst;
+	unsigned a;
+	unsigned b;
+} dag_instruction;
+
+/*
+A set of expressions of one pool compiled together as a DAG into 
+straight-line code. Every distinct node reachable from the `nouts` 
+outputs gets one value in `vals` and is computed by at most one 
+instruction, in topological order, so a subexpression shared by 
+several outputs (or used twice in one) is evaluated once per run. 
+Constants are stored in `vals` at compile time and cost nothing to 
+evaluate. Output `k` is `vals[outs[k]]`. Everything lives in one 
+allocation; `vals` is scratch space, so a dag is unsafe to run 
+from two threads at once.
+*/
+typedef struct {
+	size_t len;
+	size_t nvals;
+	size_t nouts;
+	dag_instruction* code;
+	unsigned* outs;
+	scalar* vals;
+} expr_dag;
+
+void destroy_dag(expr_dag* dag) {
+	free(dag);
+	dag = NULL;
+}
+
+/*
+Compiles the expressions `outs` (all from `pool`) into one DAG 
+program. Returns NULL if any of them is NULL or memory runs out.
+*/
+expr_dag* compile_dag(expr_pool* pool, expr** outs, size_t nouts) {
+	for (size_t k = 0; k < nouts; k++)
+		if (outs[k] == NULL)
+			return NULL;
+
+	// ids are a topological order, so one downward sweep finds 
+	// every node the outputs reach
+	unsigned* at = (unsigned*)calloc(pool->len ? pool->len : 1, sizeof(unsigned));
+	if (at == NULL) {
+		puts("error: insufficient heap memory for dag compilation");
+		return NULL;
+	}
+	for (size_t k = 0; k < nouts; k++)
+		at[outs[k]->id] = 1;
+	for (size_t id = pool->len; id-- > 0;) {
+		expr* e = pool->nodes[id];
+		if (!at[id])
+			continue;
+		if (e->lhs)
+			at[e->lhs->id] = 1;
+		if (e->rhs)
+			at[e->rhs->id] = 1;
+	}
+
+	// then values are numbered in that same order
+	size_t nvals = 0, len = 0;
+	for (size_t id = 0; id < pool->len; id++) {
+		if (!at[id])
+			continue;
+		at[id] = (unsigned)++nvals;	// value index + 1
+		if (pool->nodes[id]->op != OP_CONST)
+			len++;
+	}
+
+	size_t outs_at = sizeof(expr_dag) + sizeof(dag_instruction) * len;
+	size_t vals_at = __align_up(outs_at + sizeof(unsigned) * nouts, _Alignof(scalar));
+	expr_dag* dag = (expr_dag*)malloc(vals_at + sizeof(scalar) * (nvals ? nvals : 1));
+	if (dag == NULL) {
+		puts("error: insufficient heap memory for dag compilation");
+		free(at);
+		return NULL;
+	}
+	dag->len = len;
+	dag->nvals = nvals;
+	dag->nouts = nouts;
+	dag->code = (dag_instruction*)(dag + 1);
+	dag->outs = (unsigned*)((char*)dag + outs_at);
+	dag->vals = (scalar*)((char*)dag + vals_at);
+
+	size_t pc = 0;
+	for (size_t id = 0; id < pool->len; id++) {
+		if (!at[id])
+			continue;
+		expr* e = pool->nodes[id];
+		unsigned dst = at[id] - 1;
+		if (e->op == OP_CONST)
+			dag->vals[dst] = e->value;
+		else if (e->op == OP_VAR)
+			dag->code[pc++] = (dag_instruction){ OP_VAR, dst, e->slot, 0 };
+		else
+			dag->code[pc++] = (dag_instruction){ e->op, dst, at[e->lhs->id] - 1, e->rhs ? at[e->rhs->id] - 1 : 0 };
+	}
+	for (size_t k = 0; k < nouts; k++)
+		dag->outs[k] = at[outs[k]->id] - 1;
+
+	free(at);
+	return dag;
+}
+
+/*
+Runs a DAG program against an environment read as 
+`run_program_strided` does, writing output `k` to `out[k]`. Makes 
+no heap allocations.
+*/
+void run_dag(expr_dag* dag, const void* env, size_t stride, scalar* out) {
+	const char* base = (const char*)env;
+	scalar* v = dag->vals;
+
+	for (size_t pc = 0; pc < dag->len; pc++) {
+		dag_instruction ins = dag->code[pc];
+		switch (ins.op) {
+		case OP_VAR:	v[ins.dst] = *(const scalar*)(base + ins.a * stride);	break;
+		case OP_ADD:	v[ins.dst] = v[ins.a] + v[ins.b];	break;
+		case OP_SUB:	v[ins.dst] = v[ins.a] - v[ins.b];	break;
+		case OP_MUL:	v[ins.dst] = v[ins.a] * v[ins.b];	break;
+		case OP_DIV:	v[ins.dst] = v[ins.a] / v[ins.b];	break;
+		default:		v[ins.dst] = apply_opcode(ins.op, v[ins.a], v[ins.b]);	break;
+		}
+	}
+	for (size_t k = 0; k < dag->nouts; k++)
+		out[k] = v[dag->outs[k]];
+}
+
+/*
+The Jacobian of a system, differentiated symbolically once and 
+kept as one DAG program per equation, so refreshing it is pure 
+evaluation. Row `i` is `dags[i]`: its output 0 is equation `i` 
+itself, and its output `1 + k` is the partial w.r.t. slot 
+`colidx[rowptr[i] + k]`; partials that are identically zero are 
+left out. The residual and the partials of an equation are one 
+DAG, so the work they share (e.g. the `cos(x*y)` in both 
+`sin(x*y)` and its derivatives) is done once per row. `values[i]` 
+computes equation `i` alone, for when only residuals are needed; 
+it is built from the same expression, so repeated subterms are 
+still evaluated once, e.g. `2*3*x + sin(2*3*x)` runs as 
+`t = 6*x; t + sin(t)`.
+*/
+typedef struct {
+	size_t rows;
+	size_t cols;
+	size_t* rowptr;
+	size_t* colidx;
+	scalar* out;
+	expr_dag** values;
+	expr_dag* dags[];
+} symbolic_jacobian;
+
+void destroy_symbolic_jacobian(symbolic_jacobian* sj) {
+	for (size_t i = 0; i < 2 * sj->rows; i++)
+		if (sj->dags[i])
+			destroy_dag(sj->dags[i]);
+	free(sj->rowptr);
+	free(sj);
+	sj = NULL;
+}
+
+/*
+Differentiates every equation of a system w.r.t. every one of the 
+`cols` environment slots and compiles each equation with its 
+partials. An equation is only differentiated w.r.t. the slots it 
+reads, so `eqns` may each be compiled against an environment of 
+their own, and `cols` is then the widest of them. Returns NULL if 
+any row can't be built.
+*/
+symbolic_jacobian* new_symbolic_jacobian(program** eqns, size_t rows, size_t cols) {
+	symbolic_jacobian* sj = (symbolic_jacobian*)calloc(1, sizeof(symbolic_jacobian) + sizeof(expr_dag*) * 2 * rows);
+	size_t* buf = (size_t*)malloc(sizeof(size_t) * (rows + 1 + rows * cols) + sizeof(scalar) * (cols + 1));
+	expr** outs = (expr**)malloc(sizeof(expr*) * (cols + 1));
+	if (sj == NULL || buf == NULL || outs == NULL) {
+		puts("error: insufficient heap memory for symbolic jacobian");
+		free(sj);
+		free(buf);
+		free(outs);
+		return NULL;
+	}
+	sj->rows = rows;
+	sj->cols = cols;
+	sj->rowptr = buf;
+	sj->colidx = buf + rows + 1;
+	sj->out = (scalar*)(sj->colidx + rows * cols);
+	sj->values = sj->dags + rows;
+	sj->rowptr[0] = 0;
+
+	for (size_t i = 0; i < rows; i++) {
+		size_t nnz = sj->rowptr[i];
+		expr_pool* pool = new_expr_pool();
+		expr* e = pool ? expr_from_program(pool, eqns[i]) : NULL;
+		size_t n = 0;
+		outs[n++] = e;
+
+		for (size_t j = 0; e && j < cols; j++) {
+
+			// an equation can't depend on a slot it never reads
+			if (j >= eqns[i]->nvars || eqns[i]->names[j] == NULL)
+				continue;
+
+			expr* d = differentiate(pool, e, (unsigned)j);
+			if (d != NULL && __is_const(d, 0))
+				continue;
+			outs[n++] = d;
+			sj->colidx[nnz++] = j;
+		}
+		sj->rowptr[i + 1] = nnz;
+
+		sj->dags[i] = e ? compile_dag(pool, outs, n) : NULL;
+		sj->values[i] = e ? compile_dag(pool, &e, 1) : NULL;
+		if (pool)
+			destroy_expr_pool(pool);
+		if (sj->dags[i] == NULL || sj->values[i] == NULL) {
+			free(outs);
+			destroy_symbolic_jacobian(sj);
+			return NULL;
+		}
+	}
+	free(outs);
+	return sj;
+}
+
+/*
+Evaluates equation `i` of a symbolic Jacobian against an 
+environment read as `run_program_strided` does.
+*/
+scalar eval_symbolic_residual(symbolic_jacobian* sj, size_t i, const void* env, size_t stride) {
+	scalar res;
+	run_dag(sj->values[i], env, stride, &res);
+	return res;
+}
+
+/*
+Evaluates row `i` of a symbolic Jacobian against an environment 
+read as `run_program_strided` does, writing the partial w.r.t. 
+slot `j` to `grad[j]` for every `j` below `sj->cols` (0 for the 
+partials that were left out), and returns equation `i`'s value.
+*/
+scalar eval_symbolic_row(symbolic_jacobian* sj, size_t i, const void* env, size_t stride, scalar* grad) {
+	run_dag(sj->dags[i], env, stride, sj->out);
+	for (size_t j = 0; j < sj->cols; j++)
+		grad[j] = 0;
+	for (size_t k = sj->rowptr[i]; k < sj->rowptr[i + 1]; k++)
+		grad[sj->colidx[k]] = sj->out[1 + k - sj->rowptr[i]];
+	return sj->out[0];
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <stdlib.h>
+#include <stdbool.h>
+#include "precision.h"
+#include "bytecode.h"
+
+struct __expr {
+	unsigned op;
+	unsigned slot;
+	scalar value;
+	struct __expr* lhs;
+	struct __expr* rhs;
+	size_t id;
+};
+
+typedef struct __expr expr;
+
+typedef struct {
+	size_t len;
+	size_t cap;
+	expr** nodes;
+	size_t icap;
+	size_t* index;
+} expr_pool;
+
+expr_pool* new_expr_pool(void);
+
+void destroy_expr_pool(expr_pool* pool);
+
+size_t __expr_hash(unsigned op, unsigned slot, scalar value, expr* lhs, expr* rhs);
+
+bool __expr_equal(expr* e, unsigned op, unsigned slot, scalar value, expr* lhs, expr* rhs);
+
+size_t __expr_probe(expr_pool* pool, size_t h, unsigned op, unsigned slot, scalar value, expr* lhs, expr* rhs);
+
+bool __grow_expr_index(expr_pool* pool);
+
+expr* expr_const(expr_pool* pool, scalar value);
+
+expr* expr_var(expr_pool* pool, unsigned slot);
+
+expr* expr_node(expr_pool* pool, unsigned op, expr* lhs, expr* rhs);
+
+expr* expr_from_program(expr_pool* pool, program* prog);
+
+expr* differentiate(expr_pool* pool, expr* e, unsigned wrt);
+
+void print_expr(expr* e, char** names);
+
+size_t __expr_size(expr* e);
+
+program* compile_expr(expr* e, program* like);
+
+typedef struct {
+	unsigned op;
+	unsigned dst;
+	unsigned a;
+	unsigned b;
+} dag_instruction;
+
+typedef struct {
+	size_t len;
+	size_t nvals;
+	size_t nouts;
+	dag_instruction* code;
+	unsigned* outs;
+	scalar* vals;
+} expr_dag;
+
+void destroy_dag(expr_dag* dag);
+
+expr_dag* compile_dag(expr_pool* pool, expr** outs, size_t nouts);
+
+void run_dag(expr_dag* dag, const void* env, size_t stride, scalar* out);
+
+typedef struct {
+	size_t rows;
+	size_t cols;
+	size_t* rowptr;
+	size_t* colidx;
+	scalar* out;
+	expr_dag** values;
+	expr_dag* dags[];
+} symbolic_jacobian;
+
+symbolic_jacobian* new_symbolic_jacobian(program** eqns, size_t rows, size_t cols);
+
+void destroy_symbolic_jacobian(symbolic_jacobian* sj);
+
+scalar eval_symbolic_residual(symbolic_jacobian* sj, size_t i, const void* env, size_t stride);
+
+scalar eval_symbolic_row(symbolic_jacobian* sj, size_t i, const void* env, size_t stride, scalar* grad);
@@ -0,0 +1,152 @@
+/*
+Checks that native code from `jit_program` computes exactly what the
+interpreter does: for every expression and environment below, the
+value from `run_program` and the value and gradient from
+`run_program_gradient` must be bitwise identical with and without
+the program's native code (NaNs only have to agree on being NaN).
+A sum of `LONG_TERMS` terms, whose frame would be far over
+`JIT_STACK_MAX`, must stay on the interpreter and still evaluate
+correctly. Where the build or platform has no JIT the check is
+skipped.
+
+Build and run from the repository root:
+
+	cc -std=c11 -I. tests/jit_test.c $(ls *.c | grep -v main.c) -lm -o jit_test
+	./jit_test
+
+Exits with 0 if everything matches, 1 otherwise.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "precision.h"
+#include "dlinklist.h"
+#include "shunting.h"
+#include "bytecode.h"
+#include "jit.h"
+
+const char* exprs[] = {
+	"x",
+	"3",
+	"x*sin(y)+2^x-sqrt(y)/3",
+	"tan(x*y)/(1+y)",
+	"arcsin(x/4)*arccos(y/2)+arctan(x-y)",
+	"log(x)*ln(y)+exp(x*y)",
+	"x^y",
+	"x^3-y^2",
+	"x*0+3*(2*y)",
+	"(x-y)/(y-x*2)-(2-x)/(3/y)",
+	"x^(y-3)",
+	"1-(2-(3-(4-(5-x))))",
+	"sqrt(x*x+y*y)*exp(0-x)",
+	"z*z*z+x/z-y",
+	"2*3*x+sin(2*3*x)",
+	NULL
+};
+
+scalar envs[][3] = {
+	{ 1.3, 0.7, 2.1 },
+	{ 0.2, 2.5, -1.5 },
+	{ 0, 0.5, 1 },
+	{ -0.5, 1.5, 3 }
+};
+
+#define LONG_TERMS 300000
+
+bool same(scalar a, scalar b) {
+	return memcmp(&a, &b, sizeof(scalar)) == 0 || (isnan(a) && isnan(b));
+}
+
+program* compile_str(const char* expr) {
+	char* copy = (char*)malloc(strlen(expr) + 1);
+	if (copy == NULL)
+		return NULL;
+	strcpy(copy, expr);
+	vector* postfix = shunting_yard(words(copy));
+	free(copy);
+	program* prog = postfix ? compile_postfix(postfix) : NULL;
+	destroy_vector(postfix);
+	return prog;
+}
+
+int main(void) {
+	if (!jit_supported()) {
+		puts("jit_test: no JIT in this build, skipped");
+		return 0;
+	}
+
+	size_t checked = 0, failed = 0;
+	for (size_t e = 0; exprs[e]; e++) {
+		program* prog = compile_str(exprs[e]);
+		if (prog == NULL || !jit_program(prog)) {
+			printf("FAIL %s: can't compile natively\n", exprs[e]);
+			failed++;
+			if (prog)
+				destroy_program(prog);
+			continue;
+		}
+
+		for (size_t k = 0; k < sizeof(envs) / sizeof(envs[0]); k++) {
+			scalar native_grad[3] = { 0 }, interp_grad[3] = { 0 };
+			scalar native_val = run_program(prog, envs[k]);
+			scalar native_gval = run_program_gradient(prog, envs[k], sizeof(scalar), native_grad);
+
+			// hide the native code to get the interpreter's answers
+			native_eval eval = prog->native;
+			native_gradient gradient = prog->native_gradient;
+			prog->native = NULL;
+			prog->native_gradient = NULL;
+			scalar interp_val = run_program(prog, envs[k]);
+			scalar interp_gval = run_program_gradient(prog, envs[k], sizeof(scalar), interp_grad);
+			prog->native = eval;
+			prog->native_gradient = gradient;
+
+			bool ok = same(native_val, interp_val) && same(native_gval, interp_gval);
+			for (size_t j = 0; j < prog->nvars; j++)
+				ok = ok && same(native_grad[j], interp_grad[j]);
+
+			checked++;
+			if (!ok) {
+				failed++;
+				printf("FAIL %s at env %zu: value " SCALAR_FMT " vs " SCALAR_FMT "\n",
+					exprs[e], k, native_val, interp_val);
+			}
+		}
+		destroy_program(prog);
+	}
+
+	// x+x+...+x: two values per instruction would need ~9.6 MB of stack
+	char* sum = (char*)malloc(2 * LONG_TERMS);
+	program* prog = NULL;
+	if (sum) {
+		for (size_t i = 0; i < LONG_TERMS; i++) {
+			sum[2 * i] = 'x';
+			sum[2 * i + 1] = '+';
+		}
+		sum[2 * LONG_TERMS - 1] = '\0';
+		prog = compile_str(sum);
+		free(sum);
+	}
+	checked++;
+	if (prog == NULL) {
+		puts("FAIL long sum: can't compile");
+		failed++;
+	}
+	else {
+		scalar x = 1.5, grad = 0;
+		bool native = jit_program(prog);
+		scalar val = run_program(prog, &x);
+		scalar gval = run_program_gradient(prog, &x, sizeof(scalar), &grad);
+		if (native || val != 1.5 * LONG_TERMS || gval != val || grad != LONG_TERMS) {
+			failed++;
+			printf("FAIL long sum: native %d, value " SCALAR_FMT ", gradient " SCALAR_FMT "\n",
+				native, val, grad);
+		}
+		destroy_program(prog);
+	}
+
+	printf("jit_test: %zu checks, %zu failed\n", checked, failed);
+	return failed ? 1 : 0;
+}
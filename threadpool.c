@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <threads.h>
+
+/*
+A task run by a threadpool. Each participant is handed its own 
+contiguous block `[lo, hi)` of the range being split up.
+*/
+typedef void (*pool_task)(void* arg, size_t lo, size_t hi);
+
+/*
+A fixed set of worker threads that split a range of indices 
+(usually matrix rows) into contiguous blocks and run one task 
+over all of them. The calling thread works on the first block 
+itself, so a pool of `nthreads` runs `nthreads` blocks at once 
+with `nthreads - 1` workers.
+*/
+typedef struct {
+	size_t nthreads;
+	thrd_t* workers;
+	mtx_t lock;
+	cnd_t wake;
+	cnd_t done;
+	size_t generation;	// bumped once per `threadpool_run`
+	size_t pending;		// workers yet to finish the current generation
+	bool stopping;
+	pool_task task;
+	void* arg;
+	size_t lo;
+	size_t hi;
+} threadpool;
+
+/*
+Writes the bounds of block `part` of the pool's current range.
+*/
+void __pool_block(threadpool* tp, size_t part, size_t* lo, size_t* hi) {
+	size_t len = tp->hi - tp->lo;
+	*lo = tp->lo + len * part / tp->nthreads;
+	*hi = tp->lo + len * (part + 1) / tp->nthreads;
+}
+
+typedef struct {
+	threadpool* tp;
+	size_t part;
+} __pool_worker_arg;
+
+int __pool_worker(void* a) {
+	threadpool* tp = ((__pool_worker_arg*)a)->tp;
+	size_t part = ((__pool_worker_arg*)a)->part;
+	free(a);
+
+	size_t seen = 0;
+	mtx_lock(&tp->lock);
+	for (;;) {
+		while (tp->generation == seen && !tp->stopping)
+			cnd_wait(&tp->wake, &tp->lock);
+		if (tp->stopping)
+			break;
+		seen = tp->generation;
+		mtx_unlock(&tp->lock);
+
+		size_t lo, hi;
+		__pool_block(tp, part, &lo, &hi);
+		if (lo < hi)
+			tp->task(tp->arg, lo, hi);
+
+		mtx_lock(&tp->lock);
+		if (--tp->pending == 0)
+			cnd_signal(&tp->done);
+	}
+	mtx_unlock(&tp->lock);
+	return 0;
+}
+
+void destroy_threadpool(threadpool* tp) {
+	mtx_lock(&tp->lock);
+	tp->stopping = true;
+	cnd_broadcast(&tp->wake);
+	mtx_unlock(&tp->lock);
+
+	for (size_t i = 0; i + 1 < tp->nthreads; i++)
+		thrd_join(tp->workers[i], NULL);
+
+	cnd_destroy(&tp->done);
+	cnd_destroy(&tp->wake);
+	mtx_destroy(&tp->lock);
+	free(tp->workers);
+	free(tp);
+	tp = NULL;
+}
+
+/*
+Creates a pool that runs tasks across `nthreads` threads, the 
+caller included. Returns NULL if the threads can't be started.
+*/
+threadpool* new_threadpool(size_t nthreads) {
+	threadpool* tp = (threadpool*)calloc(1, sizeof(threadpool));
+	if (tp == NULL) {
+		puts("error: insufficient heap memory for new threadpool");
+		return NULL;
+	}
+	tp->nthreads = nthreads > 0 ? nthreads : 1;
+	tp->workers = (thrd_t*)malloc(sizeof(thrd_t) * tp->nthreads);
+	if (tp->workers == NULL) {
+		puts("error: insufficient heap memory for threadpool workers");
+		free(tp);
+		return NULL;
+	}
+	mtx_init(&tp->lock, mtx_plain);
+	cnd_init(&tp->wake);
+	cnd_init(&tp->done);
+
+	size_t started = 0;
+	for (; started + 1 < tp->nthreads; started++) {
+		__pool_worker_arg* a = (__pool_worker_arg*)malloc(sizeof(__pool_worker_arg));
+		if (a == NULL)
+			break;
+		*a = (__pool_worker_arg){ tp, started + 1 };
+		if (thrd_create(&tp->workers[started], __pool_worker, a) != thrd_success) {
+			free(a);
+			break;
+		}
+	}
+
+	if (started + 1 < tp->nthreads) {
+		puts("error: could not start every threadpool worker");
+		tp->nthreads = started + 1;	// only join the workers that exist
+		destroy_threadpool(tp);
+		return NULL;
+	}
+	return tp;
+}
+
+/*
+Runs `task` over `[lo, hi)` split into one contiguous block per 
+thread and returns once every block is done. A pool must only be 
+driven by one thread at a time.
+*/
+void threadpool_run(threadpool* tp, pool_task task, void* arg, size_t lo, size_t hi) {
+	if (tp->nthreads == 1) {
+		task(arg, lo, hi);
+		return;
+	}
+
+	mtx_lock(&tp->lock);
+	tp->task = task;
+	tp->arg = arg;
+	tp->lo = lo;
+	tp->hi = hi;
+	tp->pending = tp->nthreads - 1;
+	tp->generation++;
+	cnd_broadcast(&tp->wake);
+	mtx_unlock(&tp->lock);
+
+	size_t mylo, myhi;
+	__pool_block(tp, 0, &mylo, &myhi);
+	if (mylo < myhi)
+		task(arg, mylo, myhi);
+
+	mtx_lock(&tp->lock);
+	while (tp->pending > 0)
+		cnd_wait(&tp->done, &tp->lock);
+	mtx_unlock(&tp->lock);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <stdlib.h>
+#include <stdbool.h>
+#include <threads.h>
+
+typedef void (*pool_task)(void* arg, size_t lo, size_t hi);
+
+typedef struct {
+	size_t nthreads;
+	thrd_t* workers;
+	mtx_t lock;
+	cnd_t wake;
+	cnd_t done;
+	size_t generation;
+	size_t pending;
+	bool stopping;
+	pool_task task;
+	void* arg;
+	size_t lo;
+	size_t hi;
+} threadpool;
+
+threadpool* new_threadpool(size_t nthreads);
+
+void destroy_threadpool(threadpool* tp);
+
+void __pool_block(threadpool* tp, size_t part, size_t* lo, size_t* hi);
+
+void threadpool_run(threadpool* tp, pool_task task, void* arg, size_t lo, size_t hi);